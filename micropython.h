@@ -7,7 +7,20 @@
 #include "py/obj.h"
 #include "py/runtime.h"
 #include "py/builtin.h"
+#include "py/smallint.h"
+#include "py/objlist.h"
+#include "py/objtuple.h"
+#include "py/objarray.h"
+#include "py/objint.h"
+#include "py/objstr.h"
+#include "py/qstr.h"
+#include "py/unicode.h"
+#if MICROPY_PY_BUILTINS_FLOAT
+#include "py/formatfloat.h"
+#endif
 #include <string.h>  // for strlen()
+#include <limits.h>
+#include <math.h>  // for isnan()
 
 #include "py/lexer.h"
 #include "py/parse.h"
@@ -19,7 +32,11 @@
 // Basic Types and Constants
 // ------------------------------------------------------------
 typedef mp_obj_t PyObject;
-typedef int Py_ssize_t;
+// Py_ssize_t follows the port's word size (mp_int_t is ssize_t-sized on unix),
+// so lengths and offsets above 2 GiB survive on 64-bit builds.
+typedef mp_int_t Py_ssize_t;
+#define PY_SSIZE_T_MAX ((Py_ssize_t)(((size_t)-1) >> 1))
+#define PY_SSIZE_T_MIN (-PY_SSIZE_T_MAX - 1)
 
 #ifndef NULL
 #define NULL ((void*)0)
@@ -45,6 +62,72 @@ typedef int Py_ssize_t;
 #define __Pyx_GOTREF(obj) ((void)0)
 #define __Pyx_GIVEREF(obj) ((void)0)
 
+// ------------------------------------------------------------
+// Pending Exception State
+// ------------------------------------------------------------
+// Cython's generated code reports errors CPython-style: a NULL/-1 return with
+// the exception pending, checked through PyErr_Occurred(). Shims record the
+// exception here and return that sentinel instead of longjmp'ing through nlr
+// across Cython's C frames; __Pyx_mp_wrapper_return (see Error Handling) hands
+// it to the VM when a Python-visible wrapper returns NULL.
+// Static C data is not a GC root, so the slot lives in a small per-module state
+// object that PyModule_Create stores in the module's globals: it is reachable
+// for as long as the module is, in any build and without VM root pointers.
+// The state object is a plain 'object' instance to anything that looks at the
+// globals; the GC scans the rest of its block conservatively. Until the module
+// exists (and after __Pyx_mp_state_init) there is no slot, and an exception is
+// raised through nlr straight away. The same object holds the str index cache
+// (see Codepoint Access).
+#define __PYX_MP_STR_INDEX_SLOTS 8
+
+typedef struct {
+    mp_obj_base_t base;
+    mp_obj_t pending_exc;
+    void* str_index[__PYX_MP_STR_INDEX_SLOTS];
+} __Pyx_mp_module_state_t;
+
+static __Pyx_mp_module_state_t* __pyx_mp_state = NULL;
+
+// The pending exception, or MP_OBJ_NULL.
+static inline mp_obj_t __Pyx_mp_err_get(void) {
+    return __pyx_mp_state != NULL ? __pyx_mp_state->pending_exc : MP_OBJ_NULL;
+}
+
+static inline void __Pyx_mp_err_set(mp_obj_t exc) {
+    if (__pyx_mp_state == NULL) {
+        nlr_raise(exc);
+    }
+    __pyx_mp_state->pending_exc = exc;
+}
+
+static inline void __Pyx_mp_err_set_msg(const mp_obj_type_t* type, mp_rom_error_text_t msg) {
+    __Pyx_mp_err_set(msg != NULL ? mp_obj_new_exception_msg(type, msg) : mp_obj_new_exception(type));
+}
+
+#define PyExc_BaseException MP_OBJ_FROM_PTR(&mp_type_BaseException)
+#define PyExc_Exception MP_OBJ_FROM_PTR(&mp_type_Exception)
+#define PyExc_ArithmeticError MP_OBJ_FROM_PTR(&mp_type_ArithmeticError)
+#define PyExc_AssertionError MP_OBJ_FROM_PTR(&mp_type_AssertionError)
+#define PyExc_AttributeError MP_OBJ_FROM_PTR(&mp_type_AttributeError)
+#define PyExc_EOFError MP_OBJ_FROM_PTR(&mp_type_EOFError)
+#define PyExc_GeneratorExit MP_OBJ_FROM_PTR(&mp_type_GeneratorExit)
+#define PyExc_ImportError MP_OBJ_FROM_PTR(&mp_type_ImportError)
+#define PyExc_IndexError MP_OBJ_FROM_PTR(&mp_type_IndexError)
+#define PyExc_KeyError MP_OBJ_FROM_PTR(&mp_type_KeyError)
+#define PyExc_KeyboardInterrupt MP_OBJ_FROM_PTR(&mp_type_KeyboardInterrupt)
+#define PyExc_LookupError MP_OBJ_FROM_PTR(&mp_type_LookupError)
+#define PyExc_MemoryError MP_OBJ_FROM_PTR(&mp_type_MemoryError)
+#define PyExc_NameError MP_OBJ_FROM_PTR(&mp_type_NameError)
+#define PyExc_NotImplementedError MP_OBJ_FROM_PTR(&mp_type_NotImplementedError)
+#define PyExc_OSError MP_OBJ_FROM_PTR(&mp_type_OSError)
+#define PyExc_OverflowError MP_OBJ_FROM_PTR(&mp_type_OverflowError)
+#define PyExc_RuntimeError MP_OBJ_FROM_PTR(&mp_type_RuntimeError)
+#define PyExc_StopIteration MP_OBJ_FROM_PTR(&mp_type_StopIteration)
+#define PyExc_SystemExit MP_OBJ_FROM_PTR(&mp_type_SystemExit)
+#define PyExc_TypeError MP_OBJ_FROM_PTR(&mp_type_TypeError)
+#define PyExc_ValueError MP_OBJ_FROM_PTR(&mp_type_ValueError)
+#define PyExc_ZeroDivisionError MP_OBJ_FROM_PTR(&mp_type_ZeroDivisionError)
+
 // ============================================================
 // Container Creation Functions
 // ============================================================
@@ -63,6 +146,63 @@ static inline int PyList_SET_ITEM(PyObject* list, Py_ssize_t i, PyObject* item)
 
 #define __Pyx_PyList_SET_ITEM(list, i, item) PyList_SET_ITEM(list, i, item)
 
+// Make room for 'extra' more items, growing geometrically so repeated appends
+// and extends are amortized O(1) per item. Unused slots are kept zeroed so the
+// conservative GC does not see stale pointers.
+static inline void __Pyx_mp_list_reserve(mp_obj_list_t* self, size_t extra) {
+    size_t needed = self->len + extra;
+    if (needed <= self->alloc) {
+        return;
+    }
+    size_t new_alloc = self->alloc * 2;
+    if (new_alloc < needed) {
+        new_alloc = needed;
+    }
+    if (new_alloc < 4) {
+        new_alloc = 4;
+    }
+    self->items = m_renew(mp_obj_t, self->items, self->alloc, new_alloc);
+    memset(self->items + self->alloc, 0, (new_alloc - self->alloc) * sizeof(mp_obj_t));
+    self->alloc = new_alloc;
+}
+
+static inline void __Pyx_mp_list_extend_items(mp_obj_list_t* self, size_t n, const mp_obj_t* items) {
+    __Pyx_mp_list_reserve(self, n);
+    // memmove: 'items' may alias self->items for lst += lst.
+    memmove(self->items + self->len, items, n * sizeof(mp_obj_t));
+    self->len += n;
+}
+
+// ---------------------
+// Bytearray Growth
+// ---------------------
+// Same idea for bytearray: MicroPython's own extend grows to the exact size,
+// which makes accumulation loops quadratic. Spare capacity is bounded by the
+// width of the array's 'free' bitfield.
+static inline void __Pyx_mp_bytearray_extend_bytes(mp_obj_array_t* self, const byte* data, size_t n) {
+    if (self->free >= n) {
+        memmove((byte*)self->items + self->len, data, n);
+        self->len += n;
+        self->free -= n;
+        return;
+    }
+    size_t max_free = ((size_t)1 << MP_OBJ_ARRAY_FREE_SIZE_BITS) - 1;
+    size_t spare = self->len + n;
+    if (spare > max_free) {
+        spare = max_free;
+    }
+    // ba += ba: the source moves along with the reallocated storage.
+    bool aliased = data >= (const byte*)self->items && data < (const byte*)self->items + self->len;
+    size_t offset = aliased ? (size_t)(data - (const byte*)self->items) : 0;
+    self->items = m_renew(byte, self->items, self->len + self->free, self->len + n + spare);
+    if (aliased) {
+        data = (const byte*)self->items + offset;
+    }
+    memmove((byte*)self->items + self->len, data, n);
+    self->len += n;
+    self->free = spare;
+}
+
 // ---------------------
 // Tuple Creation and Manipulation
 // ---------------------
@@ -121,34 +261,283 @@ static inline PyObject* PySet_New(PyObject* iterable) {
 // ---------------------
 // Type Conversion Functions
 // ---------------------
-static inline long PyLong_AsLong(PyObject* obj) {
-    if (mp_obj_is_int(obj)) {
-        return mp_obj_get_int(obj);
+// ---------------------
+// C Integer Conversion
+// ---------------------
+// Small ints are encoded/decoded inline; only values outside the small-int
+// range go through mp_obj_new_int_from_ll/_from_ull or the big-int paths.
+// Out-of-range values raise OverflowError instead of being truncated. As in
+// CPython, an error is a (T)-1 return with the exception pending, which is what
+// Cython checks for ("r == (T)-1 && PyErr_Occurred()"); a -1 from a failed
+// inner conversion is passed on without replacing its exception.
+static inline int __Pyx_mp_err_int_overflow(void) {
+    __Pyx_mp_err_set_msg(&mp_type_OverflowError, MP_ERROR_TEXT("value too large to convert to C type"));
+    return -1;
+}
+
+static inline PyObject* __Pyx_mp_int_from_ll(long long v) {
+    if (v >= MP_SMALL_INT_MIN && v <= MP_SMALL_INT_MAX) {
+        return MP_OBJ_NEW_SMALL_INT((mp_int_t)v);
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected int"));
-    return 0;
+    return mp_obj_new_int_from_ll(v);
+}
+
+static inline PyObject* __Pyx_mp_int_from_ull(unsigned long long v) {
+    if (v <= (unsigned long long)MP_SMALL_INT_MAX) {
+        return MP_OBJ_NEW_SMALL_INT((mp_int_t)v);
+    }
+    return mp_obj_new_int_from_ull(v);
+}
+
+// Big-int slow path: take the low 64 bits in two's complement, then check the
+// round trip so anything that did not fit raises. The bytes are requested
+// big-endian, whatever the target's byte order, to match the loop below.
+static inline unsigned long long __Pyx_mp_bigint_low_bits(PyObject* obj) {
+    byte buf[sizeof(unsigned long long)];
+    mp_obj_int_to_bytes_impl(obj, true, sizeof(buf), buf);
+    unsigned long long v = 0;
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        v = (v << 8) | buf[i];
+    }
+    return v;
+}
+
+static inline PyObject* __Pyx_mp_int_check(PyObject* obj) {
+    if (obj == mp_const_false || obj == mp_const_true) {
+        return MP_OBJ_NEW_SMALL_INT(obj == mp_const_true);
+    }
+    if (!mp_obj_is_int(obj)) {
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected int"));
+        return MP_OBJ_NULL;
+    }
+    return obj;
+}
+
+static inline long long __Pyx_mp_int_as_ll(PyObject* obj) {
+    if (mp_obj_is_small_int(obj)) {
+        return MP_OBJ_SMALL_INT_VALUE(obj);
+    }
+    obj = __Pyx_mp_int_check(obj);
+    if (obj == MP_OBJ_NULL) {
+        return -1;
+    }
+    if (mp_obj_is_small_int(obj)) {
+        return MP_OBJ_SMALL_INT_VALUE(obj);
+    }
+    long long v = (long long)__Pyx_mp_bigint_low_bits(obj);
+    if (!mp_obj_equal(mp_obj_new_int_from_ll(v), obj)) {
+        return __Pyx_mp_err_int_overflow();
+    }
+    return v;
+}
+
+static inline unsigned long long __Pyx_mp_int_as_ull(PyObject* obj) {
+    if (mp_obj_is_small_int(obj) && MP_OBJ_SMALL_INT_VALUE(obj) >= 0) {
+        return (unsigned long long)MP_OBJ_SMALL_INT_VALUE(obj);
+    }
+    obj = __Pyx_mp_int_check(obj);
+    if (obj == MP_OBJ_NULL) {
+        return (unsigned long long)-1;
+    }
+    if (mp_obj_int_sign(obj) < 0) {
+        __Pyx_mp_err_set_msg(&mp_type_OverflowError, MP_ERROR_TEXT("can't convert negative int to unsigned"));
+        return (unsigned long long)-1;
+    }
+    if (mp_obj_is_small_int(obj)) {
+        return (unsigned long long)MP_OBJ_SMALL_INT_VALUE(obj);
+    }
+    unsigned long long v = __Pyx_mp_bigint_low_bits(obj);
+    if (!mp_obj_equal(mp_obj_new_int_from_ull(v), obj)) {
+        __Pyx_mp_err_int_overflow();
+        return (unsigned long long)-1;
+    }
+    return v;
+}
+
+#define __PYX_MP_DEFINE_INT_AS(name, ctype, lo, hi) \
+    static inline ctype __Pyx_PyInt_As_##name(PyObject* obj) { \
+        long long v = __Pyx_mp_int_as_ll(obj); \
+        if (v < (long long)(lo) || v > (long long)(hi)) { \
+            if (__Pyx_mp_err_get() == MP_OBJ_NULL) { \
+                __Pyx_mp_err_int_overflow(); \
+            } \
+            return (ctype)-1; \
+        } \
+        return (ctype)v; \
+    }
+
+#define __PYX_MP_DEFINE_UINT_AS(name, ctype, hi) \
+    static inline ctype __Pyx_PyInt_As_##name(PyObject* obj) { \
+        unsigned long long v = __Pyx_mp_int_as_ull(obj); \
+        if (v > (unsigned long long)(hi)) { \
+            if (__Pyx_mp_err_get() == MP_OBJ_NULL) { \
+                __Pyx_mp_err_int_overflow(); \
+            } \
+            return (ctype)-1; \
+        } \
+        return (ctype)v; \
+    }
+
+__PYX_MP_DEFINE_INT_AS(char, char, CHAR_MIN, CHAR_MAX)
+__PYX_MP_DEFINE_INT_AS(signed__char, signed char, SCHAR_MIN, SCHAR_MAX)
+__PYX_MP_DEFINE_INT_AS(short, short, SHRT_MIN, SHRT_MAX)
+__PYX_MP_DEFINE_INT_AS(int, int, INT_MIN, INT_MAX)
+__PYX_MP_DEFINE_INT_AS(long, long, LONG_MIN, LONG_MAX)
+__PYX_MP_DEFINE_INT_AS(PY_LONG_LONG, long long, LLONG_MIN, LLONG_MAX)
+__PYX_MP_DEFINE_UINT_AS(unsigned_char, unsigned char, UCHAR_MAX)
+__PYX_MP_DEFINE_UINT_AS(unsigned_short, unsigned short, USHRT_MAX)
+__PYX_MP_DEFINE_UINT_AS(unsigned_int, unsigned int, UINT_MAX)
+__PYX_MP_DEFINE_UINT_AS(unsigned_long, unsigned long, ULONG_MAX)
+__PYX_MP_DEFINE_UINT_AS(unsigned_PY_LONG_LONG, unsigned long long, ULLONG_MAX)
+__PYX_MP_DEFINE_UINT_AS(size_t, size_t, SIZE_MAX)
+
+#define __PYX_MP_DEFINE_INT_FROM(name, ctype) \
+    static inline PyObject* __Pyx_PyInt_From_##name(ctype v) { \
+        return __Pyx_mp_int_from_ll((long long)v); \
+    }
+
+#define __PYX_MP_DEFINE_UINT_FROM(name, ctype) \
+    static inline PyObject* __Pyx_PyInt_From_##name(ctype v) { \
+        return __Pyx_mp_int_from_ull((unsigned long long)v); \
+    }
+
+__PYX_MP_DEFINE_INT_FROM(char, char)
+__PYX_MP_DEFINE_INT_FROM(short, short)
+__PYX_MP_DEFINE_INT_FROM(int, int)
+__PYX_MP_DEFINE_INT_FROM(long, long)
+__PYX_MP_DEFINE_INT_FROM(PY_LONG_LONG, long long)
+__PYX_MP_DEFINE_UINT_FROM(unsigned_char, unsigned char)
+__PYX_MP_DEFINE_UINT_FROM(unsigned_short, unsigned short)
+__PYX_MP_DEFINE_UINT_FROM(unsigned_int, unsigned int)
+__PYX_MP_DEFINE_UINT_FROM(unsigned_long, unsigned long)
+__PYX_MP_DEFINE_UINT_FROM(unsigned_PY_LONG_LONG, unsigned long long)
+
+static inline PyObject* __Pyx_PyInt_FromSize_t(size_t v) {
+    return __Pyx_mp_int_from_ull(v);
+}
+
+static inline Py_ssize_t __Pyx_PyIndex_AsSsize_t(PyObject* obj) {
+    long long v = __Pyx_mp_int_as_ll(obj);
+    if (v < (long long)PY_SSIZE_T_MIN || v > (long long)PY_SSIZE_T_MAX) {
+        return __Pyx_mp_err_int_overflow();
+    }
+    return (Py_ssize_t)v;
 }
 
+static inline long PyLong_AsLong(PyObject* obj) {
+    return __Pyx_PyInt_As_long(obj);
+}
+
+static inline unsigned long PyLong_AsUnsignedLong(PyObject* obj) {
+    return __Pyx_PyInt_As_unsigned_long(obj);
+}
+
+static inline long long PyLong_AsLongLong(PyObject* obj) {
+    return __Pyx_mp_int_as_ll(obj);
+}
+
+static inline unsigned long long PyLong_AsUnsignedLongLong(PyObject* obj) {
+    return __Pyx_mp_int_as_ull(obj);
+}
+
+static inline Py_ssize_t PyLong_AsSsize_t(PyObject* obj) {
+    return __Pyx_PyIndex_AsSsize_t(obj);
+}
+
+static inline size_t PyLong_AsSize_t(PyObject* obj) {
+    return __Pyx_PyInt_As_size_t(obj);
+}
+
+static inline PyObject* PyLong_FromLong(long val) {
+    return __Pyx_mp_int_from_ll(val);
+}
+
+static inline PyObject* PyLong_FromUnsignedLong(unsigned long val) {
+    return __Pyx_mp_int_from_ull(val);
+}
+
+static inline PyObject* PyLong_FromLongLong(long long val) {
+    return __Pyx_mp_int_from_ll(val);
+}
+
+static inline PyObject* PyLong_FromUnsignedLongLong(unsigned long long val) {
+    return __Pyx_mp_int_from_ull(val);
+}
+
+static inline PyObject* PyLong_FromSsize_t(Py_ssize_t val) {
+    return __Pyx_mp_int_from_ll(val);
+}
+
+static inline PyObject* PyLong_FromSize_t(size_t val) {
+    return __Pyx_mp_int_from_ull(val);
+}
+
+// ---------------------
+// Float Boxing
+// ---------------------
+// Under MICROPY_OBJ_REPR_C and _D a float is encoded in the object word itself,
+// so mp_obj_new_float/mp_obj_float_get are inline bit operations and boxing is
+// free. Other representations allocate one heap object per float. Floats are
+// tested with mp_obj_is_float, which covers both encodings.
+
+// PyFloat_FromDouble: Create a new float object from a C double.
+static inline PyObject* PyFloat_FromDouble(double val) {
+    return mp_obj_new_float((mp_float_t)val);
+}
+
+// PyFloat_AsDouble: Accepts floats, ints (including big ints and bool) and
+// objects with __float__, like CPython.
 static inline double PyFloat_AsDouble(PyObject* obj) {
     if (mp_obj_is_float(obj)) {
-        return mp_obj_get_float(obj);
+        return mp_obj_float_get(obj);
+    }
+    if (mp_obj_is_small_int(obj)) {
+        return (double)MP_OBJ_SMALL_INT_VALUE(obj);
+    }
+    mp_float_t val;
+    if (mp_obj_get_float_maybe(obj, &val)) {
+        return val;
+    }
+    mp_obj_t dest[2];
+    mp_load_method_maybe(obj, MP_QSTR___float__, dest);
+    if (dest[0] != MP_OBJ_NULL) {
+        mp_obj_t res = mp_call_method_n_kw(0, 0, dest);
+        if (mp_obj_is_float(res)) {
+            return mp_obj_float_get(res);
+        }
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("__float__ returned non-float"));
+        return -1.0;
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected float"));
-    return 0.0;
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("must be real number"));
+    return -1.0;
 }
 
 static inline const char* PyUnicode_AsUTF8(PyObject* obj) {
     if (mp_obj_is_str(obj)) {
         return mp_obj_str_get_str(obj);
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected str"));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected str"));
     return NULL;
 }
 
-#define PyInt_FromLong(x) mp_obj_new_int(x)
-static PyObject* __pyx_int_1 = MP_OBJ_NEW_SMALL_INT(1);
-static PyObject* __pyx_int_2 = MP_OBJ_NEW_SMALL_INT(2);
-static PyObject* __pyx_int_3 = MP_OBJ_NEW_SMALL_INT(3);
+// PyUnicode_AsUTF8AndSize: Pointer and byte length in one O(1) call; MicroPython
+// already stores both, so no strlen is needed.
+static inline const char* PyUnicode_AsUTF8AndSize(PyObject* obj, Py_ssize_t* size) {
+    if (mp_obj_is_str(obj)) {
+        size_t len;
+        const char* data = mp_obj_str_get_data(obj, &len);
+        if (size != NULL) {
+            *size = (Py_ssize_t)len;
+        }
+        return data;
+    }
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected str"));
+    return NULL;
+}
+
+// Integer literals (__pyx_int_N) are emitted as MP_OBJ_NEW_SMALL_INT constants by
+// modify_includes.py; this only serves those outside the small int range.
+#define PyInt_FromLong(x) PyLong_FromLong(x)
 
 static inline PyObject* __Pyx_PyUnicode_FromString(const char* s) {
     return mp_obj_new_str(s, strlen(s));
@@ -173,7 +562,7 @@ static inline int PySequence_SetItem(PyObject* seq, Py_ssize_t i, PyObject* item
 static inline Py_ssize_t PySequence_Size(PyObject* seq) {
     mp_obj_t len_obj = mp_obj_len_maybe(seq);
     if (len_obj == MP_OBJ_NULL) {
-        PyErr_SetString(PyExc_TypeError, "object has no len()");
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("object has no len()"));
         return -1;
     }
     return mp_obj_get_int(len_obj);
@@ -196,16 +585,110 @@ static inline int PyObject_DelItem(PyObject* obj, PyObject* key) {
     return 0;
 }
 
+// ---------------------
+// Fast Key Lookup
+// ---------------------
+// C-string keys are converted to qstrs through a small cache keyed by the
+// string's address (Cython passes literals). A hit saves hashing the key and
+// searching the qstr pools, but it is not constant time: the entry is still
+// re-validated with strcmp against the qstr's bytes, so a reused buffer can
+// never return a stale qstr, which costs O(length of the key).
+#define __PYX_MP_QSTR_CACHE_SIZE 64
+
+typedef struct {
+    const char* key;
+    qstr q;
+} __Pyx_mp_qstr_cache_entry_t;
+
+static __Pyx_mp_qstr_cache_entry_t __Pyx_mp_qstr_cache[__PYX_MP_QSTR_CACHE_SIZE];
+
+// Returns MP_QSTRnull if the string is not interned and 'intern' is false.
+static inline qstr __Pyx_mp_qstr_from_cstr(const char* key, bool intern) {
+    __Pyx_mp_qstr_cache_entry_t* e = &__Pyx_mp_qstr_cache[((uintptr_t)key >> 3) % __PYX_MP_QSTR_CACHE_SIZE];
+    // Bound-check first: qstr pools are rebuilt on soft reset.
+    if (e->key == key && e->q < MP_STATE_VM(last_pool)->total_prev_len + MP_STATE_VM(last_pool)->len
+        && strcmp(qstr_str(e->q), key) == 0) {
+        return e->q;
+    }
+    size_t len = strlen(key);
+    qstr q = intern ? qstr_from_strn(key, len) : qstr_find_strn(key, len);
+    if (q != MP_QSTRnull) {
+        e->key = key;
+        e->q = q;
+    }
+    return q;
+}
+
+// Open-addressing probe for qstr and small-int keys, mirroring mp_map_lookup
+// but with the hash computed inline (a small int hashes to its value) and
+// interned/small-int slots compared by identity only. Everything else, and
+// ordered maps, go through mp_map_lookup.
+static inline mp_map_elem_t* __Pyx_mp_map_lookup_fast(mp_map_t* map, mp_obj_t index) {
+    mp_uint_t hash;
+    if (mp_obj_is_qstr(index)) {
+        hash = qstr_hash(MP_OBJ_QSTR_VALUE(index));
+    } else if (mp_obj_is_small_int(index)) {
+        hash = (mp_uint_t)MP_OBJ_SMALL_INT_VALUE(index);
+    } else {
+        return mp_map_lookup(map, index, MP_MAP_LOOKUP);
+    }
+    if (map->is_ordered || map->alloc == 0) {
+        return mp_map_lookup(map, index, MP_MAP_LOOKUP);
+    }
+    size_t start = hash % map->alloc;
+    size_t pos = start;
+    do {
+        mp_map_elem_t* slot = &map->table[pos];
+        if (slot->key == MP_OBJ_NULL) {
+            return NULL;
+        }
+        if (slot->key == index) {
+            return slot;
+        }
+        if (!map->all_keys_are_qstrs && slot->key != MP_OBJ_SENTINEL
+            && !mp_obj_is_qstr(slot->key) && !mp_obj_is_small_int(slot->key)
+            && mp_obj_equal(slot->key, index)) {
+            return slot;
+        }
+        pos = (pos + 1) % map->alloc;
+    } while (pos != start);
+    return NULL;
+}
+
 static inline int PyDict_SetItem(PyObject* dict, PyObject* key, PyObject* value) {
     mp_obj_dict_store(dict, key, value);
     return 0;
 }
 
+// A key that is already a qstr is stored as one, so later lookups compare by
+// identity. Other keys become heap strs: interning them would grow the qstr
+// pool for good and fails for keys of 256 bytes or more.
 static inline int PyDict_SetItemString(PyObject* dict, const char* key, PyObject* value) {
-    mp_obj_dict_store(dict, mp_obj_new_str(key, strlen(key)), value);
+    qstr q = __Pyx_mp_qstr_from_cstr(key, false);
+    mp_obj_t k = q != MP_QSTRnull ? MP_OBJ_NEW_QSTR(q) : mp_obj_new_str(key, strlen(key));
+    mp_obj_dict_store(dict, k, value);
     return 0;
 }
 
+// As in CPython, a missing key or a non-dict gives NULL without an exception.
+static inline PyObject* PyDict_GetItemString(PyObject* dict, const char* key) {
+    if (!mp_obj_is_dict_or_ordereddict(dict)) {
+        return NULL;
+    }
+    mp_map_t* map = mp_obj_dict_get_map(dict);
+    mp_map_elem_t* elem;
+    qstr q = __Pyx_mp_qstr_from_cstr(key, false);
+    if (q != MP_QSTRnull) {
+        elem = __Pyx_mp_map_lookup_fast(map, MP_OBJ_NEW_QSTR(q));
+    } else {
+        // Not interned: probe with a stack str so a miss allocates nothing.
+        size_t len = strlen(key);
+        mp_obj_str_t tmp = {{&mp_type_str}, qstr_compute_hash((const byte*)key, len), len, (const byte*)key};
+        elem = mp_map_lookup(map, MP_OBJ_FROM_PTR(&tmp), MP_MAP_LOOKUP);
+    }
+    return elem ? elem->value : NULL;
+}
+
 // ---------------------
 // Iteration Functions
 // ---------------------
@@ -221,6 +704,57 @@ static inline PyObject* PyIter_Next(PyObject* iter) {
     return item;
 }
 
+// ---------------------
+// Stack Iteration for Cython for-loops
+// ---------------------
+// Cython's generated loops index lists and tuples directly and call
+// PyObject_GetIter otherwise. modify_includes.py rewrites those calls to
+// __Pyx_mp_GetIterBuf with an mp_obj_iter_buf_t declared in the enclosing C
+// function, one per call site, so range, str, bytes etc. iterators are built
+// on the C stack instead of the heap. The result may point into the buffer,
+// so it is only valid while that function runs; generator bodies, whose
+// temporaries outlive the C frame, keep PyObject_GetIter.
+static inline PyObject* __Pyx_mp_GetIterBuf(PyObject* obj, mp_obj_iter_buf_t* iter_buf) {
+    return mp_getiter(obj, iter_buf);
+}
+
+// Hand-written loops (header helpers such as PyList_Extend) declare an
+// __Pyx_mp_iter_t in the loop's scope and iterate with __Pyx_mp_iter_next
+// until it returns NULL. Lists and tuples are walked by index with no
+// iterator object at all (the list length is re-read each step, as Python
+// does); other iterables use the struct's mp_obj_iter_buf_t. The iterator may
+// point into the struct, so it must not be copied or moved.
+typedef struct {
+    mp_obj_t seq;
+    size_t index;
+    mp_obj_t iter;
+    mp_obj_iter_buf_t iter_buf;
+} __Pyx_mp_iter_t;
+
+static inline void __Pyx_mp_iter_init(__Pyx_mp_iter_t* it, PyObject* obj) {
+    it->index = 0;
+    if (mp_obj_is_type(obj, &mp_type_list) || mp_obj_is_type(obj, &mp_type_tuple)) {
+        it->seq = obj;
+        it->iter = MP_OBJ_NULL;
+    } else {
+        it->seq = MP_OBJ_NULL;
+        it->iter = mp_getiter(obj, &it->iter_buf);
+    }
+}
+
+static inline PyObject* __Pyx_mp_iter_next(__Pyx_mp_iter_t* it) {
+    if (it->seq != MP_OBJ_NULL) {
+        if (mp_obj_is_type(it->seq, &mp_type_list)) {
+            mp_obj_list_t* list = MP_OBJ_TO_PTR(it->seq);
+            return it->index < list->len ? list->items[it->index++] : NULL;
+        }
+        mp_obj_tuple_t* tuple = MP_OBJ_TO_PTR(it->seq);
+        return it->index < tuple->len ? tuple->items[it->index++] : NULL;
+    }
+    mp_obj_t item = mp_iternext(it->iter);
+    return item == MP_OBJ_STOP_ITERATION ? NULL : item;
+}
+
 // ============================================================
 // Function Calling
 // ============================================================
@@ -290,7 +824,7 @@ static inline int PyObject_DelAttr(PyObject* obj, PyObject* attr) {
 static inline Py_ssize_t PyObject_Length(PyObject* obj) {
     mp_obj_t len_obj = mp_obj_len_maybe(obj);
     if (len_obj == MP_OBJ_NULL) {
-        mp_raise_TypeError(MP_ERROR_TEXT("object has no len()"));
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("object has no len()"));
         return -1;
     }
     return mp_obj_get_int(len_obj);
@@ -300,7 +834,7 @@ static inline int PyRun_SimpleString(const char *command) {
     // Create a new lexer for the command string.
     mp_lexer_t *lex = mp_lexer_new_from_str_len(MP_QSTR_, command, strlen(command), 0);
     if (lex == NULL) {
-        mp_raise_MemoryError();
+        __Pyx_mp_err_set_msg(&mp_type_MemoryError, NULL);
         return -1;
     }
     // Parse the command as file input (i.e. allow full statements).
@@ -334,6 +868,12 @@ static inline PyObject* PyModule_Create(PyModuleDef* def) {
                           mp_obj_new_str(def->m_doc, strlen(def->m_doc)));
     }
     def->m_dict = mp_obj_module_get_globals(module);
+    __Pyx_mp_module_state_t* state = m_new_obj(__Pyx_mp_module_state_t);
+    state->base.type = &mp_type_object;
+    state->pending_exc = MP_OBJ_NULL;
+    memset(state->str_index, 0, sizeof(state->str_index));
+    mp_obj_dict_store(def->m_dict, MP_OBJ_NEW_QSTR(qstr_from_str("__pyx_mp_state")), MP_OBJ_FROM_PTR(state));
+    __pyx_mp_state = state;
     extern PyObject* __Pyx_GetBuiltinName(const char* name);
     extern PyObject* __pyx_builtin_print;
     if (__pyx_builtin_print == NULL) {
@@ -354,7 +894,7 @@ static inline PyObject* PyModule_GetName(PyObject* module) {
     if (mp_obj_is_type(module, &mp_type_module)) {
         return mp_obj_module_get_name(module);
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected module"));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected module"));
     return NULL;
 }
 
@@ -376,18 +916,29 @@ static inline int PyModule_AddStringConstant(PyObject* module, const char* name,
 // ============================================================
 // Error Handling
 // ============================================================
+// The PyErr_* setters only record the exception; the caller returns its error
+// sentinel and Cython's generated code takes the error path.
 static inline void PyErr_SetObject(PyObject* exc, PyObject* value) {
-    if (mp_obj_is_type(exc, &mp_type_type)) {
-        mp_obj_t exc_instance = mp_obj_new_exception_arg1(exc, value);
-        mp_raise_obj(exc_instance);
+    if (value != MP_OBJ_NULL && mp_obj_is_exception_instance(value) && mp_obj_is_subclass_fast(MP_OBJ_FROM_PTR(mp_obj_get_type(value)), exc)) {
+        __Pyx_mp_err_set(value);
+    } else if (mp_obj_is_exception_type(exc)) {
+        __Pyx_mp_err_set(value == NULL || value == Py_None
+            ? mp_obj_new_exception(MP_OBJ_TO_PTR(exc))
+            : mp_obj_new_exception_arg1(MP_OBJ_TO_PTR(exc), value));
     } else {
-        mp_raise_TypeError(MP_ERROR_TEXT("exception needs to be a type"));
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("exceptions must derive from BaseException"));
     }
 }
 
-#define PyErr_SetString(exc, msg) mp_raise_msg(&mp_type_##exc, MP_ERROR_TEXT(msg))
-#define PyErr_Occurred() (mp_obj_is_exception_type(mp_err_get_raised()) ? mp_err_get_raised() : NULL)
-#define __Pyx_PyErr_SetNone(exc) mp_raise_type(&mp_type_##exc)
+static inline void PyErr_SetString(PyObject* exc, const char* msg) {
+    PyErr_SetObject(exc, mp_obj_new_str(msg, strlen(msg)));
+}
+
+static inline void PyErr_SetNone(PyObject* exc) {
+    PyErr_SetObject(exc, NULL);
+}
+
+#define __Pyx_PyErr_SetNone(exc) PyErr_SetNone(exc)
 
 static inline PyObject* PyErr_NewException(const char* name, PyObject* base, PyObject* dict) {
     mp_obj_t exc_type = mp_obj_new_type(mp_obj_new_str(name, strlen(name)), base ? base : (PyObject*)&mp_type_Exception, dict);
@@ -395,11 +946,111 @@ static inline PyObject* PyErr_NewException(const char* name, PyObject* base, PyO
 }
 
 static inline void PyErr_Clear(void) {
-    mp_err_clear();
+    if (__pyx_mp_state != NULL) {
+        __pyx_mp_state->pending_exc = MP_OBJ_NULL;
+    }
 }
 
+// Like CPython, the type of the pending exception (borrowed), or NULL.
 static inline PyObject* PyErr_Occurred(void) {
-    return mp_obj_is_exception_type(mp_err_get_raised()) ? mp_err_get_raised() : NULL;
+    mp_obj_t exc = __Pyx_mp_err_get();
+    return exc == MP_OBJ_NULL ? NULL : MP_OBJ_FROM_PTR(mp_obj_get_type(exc));
+}
+
+static inline int PyErr_GivenExceptionMatches(PyObject* given, PyObject* exc) {
+    if (given == NULL || exc == NULL) {
+        return 0;
+    }
+    if (mp_obj_is_type(exc, &mp_type_tuple)) {
+        size_t len;
+        mp_obj_t* items;
+        mp_obj_tuple_get(exc, &len, &items);
+        for (size_t i = 0; i < len; i++) {
+            if (PyErr_GivenExceptionMatches(given, items[i])) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+    if (mp_obj_is_exception_instance(given)) {
+        given = MP_OBJ_FROM_PTR(mp_obj_get_type(given));
+    }
+    return mp_obj_is_subclass_fast(given, exc);
+}
+
+static inline int PyErr_ExceptionMatches(PyObject* exc) {
+    return PyErr_GivenExceptionMatches(PyErr_Occurred(), exc);
+}
+
+// ---------------------
+// Wrapper Boundary
+// ---------------------
+// The one place an exception crosses from Cython's return-NULL convention into
+// MicroPython's nlr: modify_includes.py makes every Python-visible wrapper
+// (__pyx_pw_*) return through __Pyx_mp_wrapper_return, which raises the pending
+// exception into the VM when the result is NULL. Errors raised through nlr by
+// MicroPython runtime calls below the wrapper already propagate to the VM and
+// pass straight through, so the successful path costs one NULL check and no
+// nlr_push.
+static inline void __Pyx_mp_raise_pending(void) {
+    mp_obj_t exc = __Pyx_mp_err_get();
+    PyErr_Clear();
+    if (exc == MP_OBJ_NULL) {
+        mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("error return without exception set"));
+    }
+    nlr_raise(exc);
+}
+
+static inline PyObject* __Pyx_mp_wrapper_return(PyObject* result) {
+    if (result == NULL) {
+        __Pyx_mp_raise_pending();
+    }
+    return result;
+}
+
+// ---------------------
+// Traceback Bridge
+// ---------------------
+// modify_includes.py points Cython's __Pyx_AddTraceback call sites here: instead
+// of CPython code and frame objects, each Cython frame is one entry in the
+// pending exception's own traceback storage. The function name is a build-time
+// qstr when --qstrdefs is used. Exceptions that MicroPython's runtime raises
+// through nlr never reach Cython's error labels, so they carry only the VM's
+// frames. Nothing here may raise, or a MemoryError would replace the exception
+// being reported: names are looked up, not interned, except the file name,
+// which is interned under an nlr guard (once, via the qstr cache).
+static inline qstr __Pyx_mp_traceback_file(const char* filename) {
+    if (filename == NULL) {
+        return MP_QSTR_;
+    }
+    qstr file = __Pyx_mp_qstr_from_cstr(filename, false);
+    if (file == MP_QSTRnull) {
+        nlr_buf_t nlr;
+        if (nlr_push(&nlr) != 0) {
+            return MP_QSTR_;
+        }
+        file = __Pyx_mp_qstr_from_cstr(filename, true);
+        nlr_pop();
+    }
+    return file;
+}
+
+static inline void __Pyx_mp_add_traceback(qstr block, int py_line, const char* filename) {
+    mp_obj_t exc = __Pyx_mp_err_get();
+    if (exc == MP_OBJ_NULL) {
+        return;
+    }
+    mp_obj_exception_add_traceback(exc, __Pyx_mp_traceback_file(filename), (size_t)py_line, block);
+}
+
+// Run-time named variant for function names that are not qstr-compatible; the
+// name is normally interned already as the function's own identifier.
+static inline void __Pyx_mp_AddTraceback(const char* funcname, int py_line, const char* filename) {
+    if (__Pyx_mp_err_get() == MP_OBJ_NULL) {
+        return;
+    }
+    qstr block = __Pyx_mp_qstr_from_cstr(funcname, false);
+    __Pyx_mp_add_traceback(block != MP_QSTRnull ? block : MP_QSTR_, py_line, filename);
 }
 
 // --- New additions for extended CPython API support in MicroPython --- //
@@ -414,23 +1065,27 @@ static inline void PyErr_Format(PyObject *exc, const char *fmt, ...) {
     PyErr_SetString(exc, buffer);
 }
 
-// PyErr_Fetch: Retrieve (and clear) the current exception state (minimal stub).
+// PyErr_Fetch: Take the pending exception (type, instance; no separate traceback
+// object, it lives on the instance) and clear it.
 static inline void PyErr_Fetch(PyObject **ptype, PyObject **pvalue, PyObject **ptraceback) {
-    PyObject *exc = PyErr_Occurred();
-    if (exc) {
-        *ptype = exc;
+    mp_obj_t exc = __Pyx_mp_err_get();
+    *ptraceback = NULL;
+    if (exc != MP_OBJ_NULL) {
+        *ptype = MP_OBJ_FROM_PTR(mp_obj_get_type(exc));
         *pvalue = exc;
-        *ptraceback = NULL;
         PyErr_Clear();
     } else {
-        *ptype = *pvalue = *ptraceback = NULL;
+        *ptype = *pvalue = NULL;
     }
 }
 
-// PyErr_Restore: Restore exception state (stub; simply raises the passed exception).
+// PyErr_Restore: Make (type, value) pending again, as returned by PyErr_Fetch.
 static inline void PyErr_Restore(PyObject *ptype, PyObject *pvalue, PyObject *ptraceback) {
-    if (pvalue) {
-        mp_raise_obj(pvalue);
+    (void)ptraceback;
+    if (ptype == NULL) {
+        PyErr_Clear();
+    } else {
+        PyErr_SetObject(ptype, pvalue);
     }
 }
 
@@ -460,36 +1115,9 @@ static inline void PyMem_Free(void* ptr) {
 
 // PyArg_ParseTupleAndKeywords: Minimal stub (does not support keyword arguments).
 static inline int PyArg_ParseTupleAndKeywords(PyObject* args, PyObject* kwargs, const char* format, char* kwlist[], ...) {
-    mp_raise_NotImplementedError("PyArg_ParseTupleAndKeywords is not implemented in MicroPython");
-    return 0;
-}
-
-// Extended long conversion functions.
-static inline long long PyLong_AsLongLong(PyObject* obj) {
-    if (mp_obj_is_int(obj)) {
-        return (long long)mp_obj_get_int(obj);
-    }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected int"));
-    return 0;
-}
-static inline PyObject* PyLong_FromLongLong(long long val) {
-    return mp_obj_new_int(val);
-}
-static inline unsigned long long PyLong_AsUnsignedLongLong(PyObject* obj) {
-    if (mp_obj_is_int(obj)) {
-        long long val = mp_obj_get_int(obj);
-        if (val < 0) {
-            mp_raise_ValueError(MP_ERROR_TEXT("unsigned conversion: negative value"));
-            return 0;
-        }
-        return (unsigned long long)val;
-    }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected int"));
+    __Pyx_mp_err_set_msg(&mp_type_NotImplementedError, MP_ERROR_TEXT("PyArg_ParseTupleAndKeywords is not implemented in MicroPython"));
     return 0;
 }
-static inline PyObject* PyLong_FromUnsignedLongLong(unsigned long long val) {
-    return mp_obj_new_int(val);
-}
 
 // PyErr_WriteUnraisable: Write out unraisable exceptions (minimal stub).
 static inline void PyErr_WriteUnraisable(PyObject *obj) {
@@ -521,75 +1149,597 @@ static inline const char* PyObject_AsString(PyObject* obj) {
     return mp_obj_str_get_str(obj);
 }
 
-// ---------------------
-// Byte String Operations
-// ---------------------
-static inline PyObject* PyBytes_FromString(const char* s) {
-    return mp_obj_new_bytes((const byte*)s, strlen(s));
-}
-
-static inline PyObject* PyBytes_FromStringAndSize(const char* s, Py_ssize_t len) {
-    if (s == NULL) {
-        return mp_obj_new_bytes(NULL, 0);
+// __Pyx_PyObject_AsStringAndSize: Zero-copy pointer and length for str, bytes
+// and bytearray (anything else exposing a buffer is accepted too).
+static inline const char* __Pyx_PyObject_AsStringAndSize(PyObject* obj, Py_ssize_t* length) {
+    if (mp_obj_is_str_or_bytes(obj)) {
+        size_t len;
+        const char* data = mp_obj_str_get_data(obj, &len);
+        *length = (Py_ssize_t)len;
+        return data;
     }
-    return mp_obj_new_bytes((const byte*)s, (size_t)len);
-}
-
-static inline char* PyBytes_AsString(PyObject* obj) {
-    if (mp_obj_is_type(obj, &mp_type_bytes)) {
-        mp_buffer_info_t bufinfo;
-        mp_get_buffer_raise(obj, &bufinfo, MP_BUFFER_READ);
-        return (char*)bufinfo.buf;
+    mp_buffer_info_t bufinfo;
+    if (mp_get_buffer(obj, &bufinfo, MP_BUFFER_READ)) {
+        *length = (Py_ssize_t)bufinfo.len;
+        return (const char*)bufinfo.buf;
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected bytes"));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected bytes, bytearray or str"));
     return NULL;
 }
 
-static inline Py_ssize_t PyBytes_Size(PyObject* obj) {
-    if (mp_obj_is_type(obj, &mp_type_bytes)) {
-        return mp_obj_bytes_get_len(obj);
-    }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected bytes"));
-    return -1;
+static inline const char* __Pyx_PyObject_AsString(PyObject* obj) {
+    Py_ssize_t ignore;
+    return __Pyx_PyObject_AsStringAndSize(obj, &ignore);
 }
 
-#define PyBytes_GET_SIZE(obj) PyBytes_Size(obj)
-#define PyBytes_AS_STRING(obj) PyBytes_AsString(obj)
+#define __Pyx_PyObject_AsSString(obj) ((const signed char*)__Pyx_PyObject_AsString(obj))
+#define __Pyx_PyObject_AsUString(obj) ((const unsigned char*)__Pyx_PyObject_AsString(obj))
 
 // ---------------------
-// Bytearray Operations
+// Codepoint Access
 // ---------------------
-static inline PyObject* PyByteArray_FromObject(PyObject* obj) {
-    mp_obj_t bytearray_func = mp_load_global(MP_QSTR_bytearray);
-    return mp_call_function_1(bytearray_func, obj);
-}
+// str is stored as UTF-8, so codepoint index -> byte offset is a scan. For
+// longer non-ASCII strings a sparse index (the byte offset of every
+// __PYX_MP_STR_INDEX_STRIDE-th codepoint) is built on first use and kept in a
+// small cache in the module state, so the index lives on the GC heap and
+// keeps its string alive only until it is evicted. ASCII strings are flagged
+// and need no offsets at all. An indexed lookup then walks at most
+// STRIDE - 1 codepoints, making s[i] loops linear overall. The cache is
+// 2-way set associative with LRU replacement, so two strings that map to the
+// same set and are indexed alternately both stay cached instead of rebuilding
+// each other's index on every access. Before the module state exists every
+// lookup scans.
+#define __PYX_MP_STR_INDEX MICROPY_PY_BUILTINS_STR_UNICODE
+#define __PYX_MP_STR_INDEX_STRIDE 32
+#define __PYX_MP_STR_INDEX_WAYS 2
+#define __PYX_MP_STR_INDEX_MIN_BYTES 64
 
-static inline PyObject* PyByteArray_FromStringAndSize(const char* s, Py_ssize_t len) {
-    PyObject* bytes = PyBytes_FromStringAndSize(s, len);
-    return PyByteArray_FromObject(bytes);
+typedef struct {
+    mp_obj_t str;
+    size_t char_len;
+    bool ascii;
+    size_t offsets[];
+} __Pyx_mp_str_index_t;
+
+// Byte offset of codepoint 'index' in UTF-8 data, by scanning.
+static inline size_t __Pyx_mp_utf8_offset(const byte* data, size_t blen, size_t index) {
+    size_t off = 0;
+    while (index > 0 && off < blen) {
+        off++;
+        while (off < blen && (data[off] & 0xC0) == 0x80) {
+            off++;
+        }
+        index--;
+    }
+    return off;
 }
 
-static inline char* PyByteArray_AsString(PyObject* obj) {
-    if (mp_obj_is_type(obj, &mp_type_bytearray)) {
-        mp_buffer_info_t bufinfo;
-        mp_get_buffer_raise(obj, &bufinfo, MP_BUFFER_READ);
-        return (char*)bufinfo.buf;
+#if __PYX_MP_STR_INDEX
+// The cached index of a str, built on a miss; NULL if there is no module state.
+static inline __Pyx_mp_str_index_t* __Pyx_mp_str_index_get(mp_obj_t str, const byte* data, size_t blen) {
+    if (__pyx_mp_state == NULL) {
+        return NULL;
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected bytearray"));
-    return NULL;
+    size_t sets = __PYX_MP_STR_INDEX_SLOTS / __PYX_MP_STR_INDEX_WAYS;
+    void** set = &__pyx_mp_state->str_index[((uintptr_t)str >> 4) % sets * __PYX_MP_STR_INDEX_WAYS];
+    __Pyx_mp_str_index_t* idx;
+    // Ways are kept most recently used first.
+    for (size_t way = 0; way < __PYX_MP_STR_INDEX_WAYS; way++) {
+        idx = set[way];
+        if (idx != NULL && idx->str == str) {
+            memmove(set + 1, set, way * sizeof(void*));
+            set[0] = idx;
+            return idx;
+        }
+    }
+    size_t char_len = utf8_charlen(data, blen);
+    bool ascii = char_len == blen;
+    size_t n_marks = ascii ? 0 : (char_len + __PYX_MP_STR_INDEX_STRIDE - 1) / __PYX_MP_STR_INDEX_STRIDE;
+    idx = m_malloc(sizeof(__Pyx_mp_str_index_t) + n_marks * sizeof(size_t));
+    idx->str = str;
+    idx->char_len = char_len;
+    idx->ascii = ascii;
+    size_t off = 0;
+    for (size_t m = 0; m < n_marks; m++) {
+        idx->offsets[m] = off;
+        off += __Pyx_mp_utf8_offset(data + off, blen - off, __PYX_MP_STR_INDEX_STRIDE);
+    }
+    // Evict the least recently used way.
+    memmove(set + 1, set, (__PYX_MP_STR_INDEX_WAYS - 1) * sizeof(void*));
+    set[0] = idx;
+    return idx;
 }
+#endif
 
-static inline Py_ssize_t PyByteArray_Size(PyObject* obj) {
-    if (mp_obj_is_type(obj, &mp_type_bytearray)) {
-        return mp_obj_len(obj);
+// Number of codepoints in a str.
+static inline size_t __Pyx_mp_str_char_len(PyObject* str) {
+    size_t blen;
+    const byte* data = (const byte*)mp_obj_str_get_data(str, &blen);
+    #if MICROPY_PY_BUILTINS_STR_UNICODE
+    #if __PYX_MP_STR_INDEX
+    if (blen >= __PYX_MP_STR_INDEX_MIN_BYTES) {
+        __Pyx_mp_str_index_t* idx = __Pyx_mp_str_index_get(str, data, blen);
+        if (idx != NULL) {
+            return idx->char_len;
+        }
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected bytearray"));
-    return -1;
+    #endif
+    return utf8_charlen(data, blen);
+    #else
+    (void)data;
+    return blen;
+    #endif
+}
+
+// Byte offset of codepoint 'index' (0 <= index <= length) in a str.
+static inline size_t __Pyx_mp_str_byte_offset(PyObject* str, size_t index) {
+    size_t blen;
+    const byte* data = (const byte*)mp_obj_str_get_data(str, &blen);
+    #if MICROPY_PY_BUILTINS_STR_UNICODE
+    #if __PYX_MP_STR_INDEX
+    __Pyx_mp_str_index_t* idx = blen >= __PYX_MP_STR_INDEX_MIN_BYTES ? __Pyx_mp_str_index_get(str, data, blen) : NULL;
+    if (idx != NULL) {
+        if (idx->ascii) {
+            return index;
+        }
+        size_t mark = index / __PYX_MP_STR_INDEX_STRIDE;
+        if (mark >= (idx->char_len + __PYX_MP_STR_INDEX_STRIDE - 1) / __PYX_MP_STR_INDEX_STRIDE) {
+            return blen;
+        }
+        size_t off = idx->offsets[mark];
+        return off + __Pyx_mp_utf8_offset(data + off, blen - off, index % __PYX_MP_STR_INDEX_STRIDE);
+    }
+    #endif
+    return __Pyx_mp_utf8_offset(data, blen, index);
+    #else
+    (void)data;
+    return index < blen ? index : blen;
+    #endif
+}
+
+typedef uint32_t Py_UCS4;
+
+static inline Py_ssize_t PyUnicode_GetLength(PyObject* obj) {
+    if (!mp_obj_is_str(obj)) {
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected str"));
+        return -1;
+    }
+    return (Py_ssize_t)__Pyx_mp_str_char_len(obj);
+}
+
+#define PyUnicode_GET_LENGTH(obj) PyUnicode_GetLength(obj)
+#define __Pyx_PyUnicode_GET_LENGTH(obj) PyUnicode_GetLength(obj)
+
+// PyUnicode_READ_CHAR: Codepoint at index i (no bounds check, as in CPython).
+static inline Py_UCS4 PyUnicode_READ_CHAR(PyObject* obj, Py_ssize_t i) {
+    size_t blen;
+    const byte* data = (const byte*)mp_obj_str_get_data(obj, &blen);
+    size_t off = __Pyx_mp_str_byte_offset(obj, (size_t)i);
+    #if MICROPY_PY_BUILTINS_STR_UNICODE
+    return (Py_UCS4)utf8_get_char(data + off);
+    #else
+    return data[off];
+    #endif
+}
+
+#define __Pyx_PyUnicode_READ_CHAR(obj, i) PyUnicode_READ_CHAR(obj, i)
+
+// As in Cython's GetItemIntUnicode utility, which modify_includes.py drops.
+#define __Pyx_GetItemInt_Unicode(o, i, type, is_signed, to_py_func, is_list, wraparound, boundscheck) \
+    (__Pyx_fits_Py_ssize_t(i, type, is_signed) ? \
+    __Pyx_GetItemInt_Unicode_Fast(o, (Py_ssize_t)i, wraparound, boundscheck) : \
+    (PyErr_SetString(PyExc_IndexError, "string index out of range"), (Py_UCS4)-1))
+
+static inline Py_UCS4 __Pyx_GetItemInt_Unicode_Fast(PyObject* ustring, Py_ssize_t i, int wraparound, int boundscheck) {
+    if (wraparound || boundscheck) {
+        Py_ssize_t length = (Py_ssize_t)__Pyx_mp_str_char_len(ustring);
+        if (wraparound && i < 0) {
+            i += length;
+        }
+        if (boundscheck && (i < 0 || i >= length)) {
+            __Pyx_mp_err_set_msg(&mp_type_IndexError, MP_ERROR_TEXT("string index out of range"));
+            return (Py_UCS4)-1;
+        }
+    }
+    return PyUnicode_READ_CHAR(ustring, i);
 }
 
 // ---------------------
-// Additional Type Checking for Bytes
-// ---------------------
+// String Building
+// ---------------------
+// f-strings and ''.join compile to __Pyx_PyUnicode_Join. The total byte length
+// is summed first, the result buffer is allocated once, and each piece is
+// memcpy'd in, so building a string is linear. The __Pyx_StrBuilder_*
+// helpers expose the same vstr-based approach and format ints and floats
+// straight into the buffer without creating intermediate str objects.
+// The repr precision mirrors MP_FLOAT_REPR_PREC, which is private to
+// py/objfloat.c: 7 digits for single precision builds, 16 for double.
+#if MICROPY_FLOAT_IMPL == MICROPY_FLOAT_IMPL_FLOAT
+#define __PYX_MP_FLOAT_REPR_PREC 7
+#else
+#define __PYX_MP_FLOAT_REPR_PREC 16
+#endif
+
+static inline void __Pyx_StrBuilder_Init(vstr_t* b, size_t size_hint) {
+    vstr_init(b, size_hint);
+}
+
+static inline void __Pyx_StrBuilder_AppendUTF8(vstr_t* b, const char* data, size_t len) {
+    vstr_add_strn(b, data, len);
+}
+
+static inline void __Pyx_StrBuilder_AppendInt(vstr_t* b, mp_int_t value) {
+    char buf[sizeof(mp_int_t) * 3 + 2];
+    char* p = buf + sizeof(buf);
+    mp_uint_t u = value < 0 ? -(mp_uint_t)value : (mp_uint_t)value;
+    do {
+        *--p = '0' + (char)(u % 10);
+        u /= 10;
+    } while (u != 0);
+    if (value < 0) {
+        *--p = '-';
+    }
+    vstr_add_strn(b, p, (size_t)(buf + sizeof(buf) - p));
+}
+
+#if MICROPY_PY_BUILTINS_FLOAT
+// Same text as str(float): repr precision, and ".0" for integral values.
+static inline void __Pyx_StrBuilder_AppendFloat(vstr_t* b, mp_float_t value) {
+    char buf[32];
+    mp_format_float(value, buf, sizeof(buf), 'g', __PYX_MP_FLOAT_REPR_PREC, '\0');
+    vstr_add_str(b, buf);
+    if (strchr(buf, '.') == NULL && strchr(buf, 'e') == NULL && strchr(buf, 'n') == NULL) {
+        vstr_add_strn(b, ".0", 2);
+    }
+}
+#endif
+
+// Appends str(obj); small ints, floats and strs are handled without a detour
+// through a temporary str object.
+static inline void __Pyx_StrBuilder_AppendObj(vstr_t* b, PyObject* obj) {
+    if (mp_obj_is_str(obj)) {
+        size_t len;
+        const char* data = mp_obj_str_get_data(obj, &len);
+        vstr_add_strn(b, data, len);
+    } else if (mp_obj_is_small_int(obj)) {
+        __Pyx_StrBuilder_AppendInt(b, MP_OBJ_SMALL_INT_VALUE(obj));
+    #if MICROPY_PY_BUILTINS_FLOAT
+    } else if (mp_obj_is_float(obj)) {
+        __Pyx_StrBuilder_AppendFloat(b, mp_obj_float_get(obj));
+    #endif
+    } else {
+        mp_print_t print;
+        print.data = b;
+        print.print_strn = (mp_print_strn_t)vstr_add_strn;
+        mp_obj_print_helper(&print, obj, PRINT_STR);
+    }
+}
+
+static inline PyObject* __Pyx_StrBuilder_Finish(vstr_t* b) {
+    return mp_obj_new_str_from_vstr(b);
+}
+
+// __Pyx_PyObject_FormatSimple: str(obj) for f-string fields with no format spec.
+static inline PyObject* __Pyx_PyObject_FormatSimple(PyObject* obj, PyObject* format_spec) {
+    (void)format_spec;
+    if (mp_obj_is_str(obj)) {
+        return obj;
+    }
+    vstr_t b;
+    __Pyx_StrBuilder_Init(&b, 24);
+    __Pyx_StrBuilder_AppendObj(&b, obj);
+    return __Pyx_StrBuilder_Finish(&b);
+}
+
+// __Pyx_PyUnicode_Join: Concatenate value_count strs in one allocation. The
+// UCS4 length and max_char hints from Cython don't apply to UTF-8 storage.
+static inline PyObject* __Pyx_PyUnicode_Join(PyObject* value_tuple, Py_ssize_t value_count,
+                                             Py_ssize_t result_ulength, Py_UCS4 max_char) {
+    (void)result_ulength;
+    (void)max_char;
+    mp_obj_t* items;
+    mp_obj_get_array_fixed_n(value_tuple, (size_t)value_count, &items);
+    size_t total = 0;
+    for (Py_ssize_t i = 0; i < value_count; i++) {
+        size_t len;
+        mp_obj_str_get_data(items[i], &len);
+        total += len;
+    }
+    vstr_t b;
+    vstr_init_len(&b, total);
+    char* out = b.buf;
+    for (Py_ssize_t i = 0; i < value_count; i++) {
+        size_t len;
+        const char* data = mp_obj_str_get_data(items[i], &len);
+        memcpy(out, data, len);
+        out += len;
+    }
+    return mp_obj_new_str_from_vstr(&b);
+}
+
+// PyUnicode_Join: separator.join(seq) for a list/tuple of strs, in one pass
+// over the lengths and one allocation; other iterables use str.join.
+static inline PyObject* PyUnicode_Join(PyObject* separator, PyObject* seq) {
+    if (!mp_obj_is_type(seq, &mp_type_list) && !mp_obj_is_type(seq, &mp_type_tuple)) {
+        mp_obj_t dest[3];
+        mp_load_method(separator, MP_QSTR_join, dest);
+        dest[2] = seq;
+        return mp_call_method_n_kw(1, 0, dest);
+    }
+    size_t n;
+    mp_obj_t* items;
+    mp_obj_get_array(seq, &n, &items);
+    size_t sep_len;
+    const char* sep = mp_obj_str_get_data(separator, &sep_len);
+    size_t total = n > 0 ? (n - 1) * sep_len : 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!mp_obj_is_str(items[i])) {
+            __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("join expects a list of str"));
+            return NULL;
+        }
+        size_t len;
+        mp_obj_str_get_data(items[i], &len);
+        total += len;
+    }
+    vstr_t b;
+    vstr_init_len(&b, total);
+    char* out = b.buf;
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0) {
+            memcpy(out, sep, sep_len);
+            out += sep_len;
+        }
+        size_t len;
+        const char* data = mp_obj_str_get_data(items[i], &len);
+        memcpy(out, data, len);
+        out += len;
+    }
+    return mp_obj_new_str_from_vstr(&b);
+}
+
+// ---------------------
+// String Equality and Constant Dispatch
+// ---------------------
+// __Pyx_PyUnicode_Equals: Interned strs are equal iff they are the same qstr,
+// so two qstrs never need their bytes compared. Otherwise lengths and cached
+// hashes are compared before falling back to memcmp.
+static inline int __Pyx_PyUnicode_Equals(PyObject* s1, PyObject* s2, int equals) {
+    if (s1 == s2) {
+        return equals == Py_EQ;
+    }
+    if (mp_obj_is_qstr(s1) && mp_obj_is_qstr(s2)) {
+        return equals == Py_NE;
+    }
+    if (!mp_obj_is_str(s1) || !mp_obj_is_str(s2)) {
+        return mp_obj_equal(s1, s2) == (equals == Py_EQ);
+    }
+    GET_STR_HASH(s1, h1);
+    GET_STR_HASH(s2, h2);
+    // A hash of 0 means "not computed", so only two real hashes can differ.
+    if (h1 != 0 && h2 != 0 && h1 != h2) {
+        return equals == Py_NE;
+    }
+    GET_STR_DATA_LEN(s1, d1, l1);
+    GET_STR_DATA_LEN(s2, d2, l2);
+    int eq = l1 == l2 && memcmp(d1, d2, l1) == 0;
+    return eq == (equals == Py_EQ);
+}
+
+// Dispatch an incoming str against a fixed set of constant strings (a long
+// if/elif chain) with two hashes and one memcmp, using a minimal-effort
+// hash-and-displace perfect hash built on first use:
+//
+//     __PYX_STR_SWITCH_DEFINE(methods, "GET", "PUT", "POST", "DELETE");
+//     switch (__Pyx_StrSwitch_Lookup(&methods, token)) { case 0: ... }
+//
+// Lookup returns the index of the matching constant, or -1.
+typedef struct {
+    const char* const* keys;
+    size_t* lens;  // strlen of each key, filled in by the build
+    uint16_t* disp;
+    uint16_t* slots;
+    uint16_t n_keys;
+    uint8_t state;  // 0 = not built, 1 = perfect hash, 2 = linear fallback
+} __Pyx_StrSwitch_t;
+
+#define __PYX_STR_SWITCH_DEFINE(name, ...) \
+    static const char* const name##_keys[] = { __VA_ARGS__ }; \
+    static size_t name##_lens[sizeof(name##_keys) / sizeof(name##_keys[0])]; \
+    static uint16_t name##_disp[sizeof(name##_keys) / sizeof(name##_keys[0])]; \
+    static uint16_t name##_slots[2 * sizeof(name##_keys) / sizeof(name##_keys[0])]; \
+    static __Pyx_StrSwitch_t name = { name##_keys, name##_lens, name##_disp, name##_slots, \
+                                      sizeof(name##_keys) / sizeof(name##_keys[0]), 0 }
+
+static inline uint32_t __Pyx_mp_str_switch_hash(const byte* data, size_t len, uint32_t seed) {
+    uint32_t h = 2166136261u ^ (seed * 0x9E3779B1u);
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ data[i]) * 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+static void __Pyx_mp_str_switch_build(__Pyx_StrSwitch_t* sw) {
+    size_t n = sw->n_keys;
+    size_t m = 2 * n;
+    memset(sw->slots, 0, m * sizeof(uint16_t));
+    memset(sw->disp, 0, n * sizeof(uint16_t));
+    uint16_t* bucket_of = m_new(uint16_t, n);
+    for (size_t k = 0; k < n; k++) {
+        sw->lens[k] = strlen(sw->keys[k]);
+        bucket_of[k] = (uint16_t)(__Pyx_mp_str_switch_hash((const byte*)sw->keys[k], sw->lens[k], 0) % n);
+    }
+    // Place buckets (keyed by the seed-0 hash) largest first, trying
+    // displacement seeds until all of a bucket's keys land in free slots.
+    // Buckets of more than 8 keys are hopeless; use the linear scan.
+    sw->state = 2;
+    for (size_t size = 8 + 1; size > 0; size--) {
+        for (size_t b = 0; b < n; b++) {
+            uint16_t members[8 + 1];
+            size_t count = 0;
+            for (size_t k = 0; k < n && count <= 8; k++) {
+                if (bucket_of[k] == b) {
+                    members[count++] = (uint16_t)k;
+                }
+            }
+            if (count != size) {
+                continue;
+            }
+            if (count > 8) {
+                goto done;
+            }
+            uint16_t d;
+            for (d = 1; d != 0; d++) {
+                size_t placed[8];
+                size_t i;
+                for (i = 0; i < count; i++) {
+                    uint16_t k = members[i];
+                    size_t slot = __Pyx_mp_str_switch_hash((const byte*)sw->keys[k], sw->lens[k], d) % m;
+                    size_t j;
+                    for (j = 0; j < i && placed[j] != slot; j++) {
+                    }
+                    if (sw->slots[slot] != 0 || j < i) {
+                        break;
+                    }
+                    placed[i] = slot;
+                }
+                if (i == count) {
+                    for (i = 0; i < count; i++) {
+                        sw->slots[placed[i]] = (uint16_t)(members[i] + 1);
+                    }
+                    sw->disp[b] = d;
+                    break;
+                }
+            }
+            if (d == 0) {
+                goto done;
+            }
+        }
+    }
+    sw->state = 1;
+done:
+    m_del(uint16_t, bucket_of, n);
+}
+
+static inline int __Pyx_StrSwitch_Lookup(__Pyx_StrSwitch_t* sw, PyObject* s) {
+    if (!mp_obj_is_str(s) || sw->n_keys == 0) {
+        return -1;
+    }
+    if (sw->state == 0) {
+        __Pyx_mp_str_switch_build(sw);
+    }
+    size_t len;
+    const byte* data = (const byte*)mp_obj_str_get_data(s, &len);
+    if (sw->state == 1) {
+        size_t b = __Pyx_mp_str_switch_hash(data, len, 0) % sw->n_keys;
+        size_t slot = __Pyx_mp_str_switch_hash(data, len, sw->disp[b]) % (2 * (size_t)sw->n_keys);
+        int k = (int)sw->slots[slot] - 1;
+        if (k >= 0 && sw->lens[k] == len && memcmp(sw->keys[k], data, len) == 0) {
+            return k;
+        }
+        return -1;
+    }
+    for (size_t k = 0; k < sw->n_keys; k++) {
+        if (sw->lens[k] == len && memcmp(sw->keys[k], data, len) == 0) {
+            return (int)k;
+        }
+    }
+    return -1;
+}
+
+// ---------------------
+// Byte String Operations
+// ---------------------
+static inline PyObject* PyBytes_FromString(const char* s) {
+    return mp_obj_new_bytes((const byte*)s, strlen(s));
+}
+
+static inline PyObject* PyBytes_FromStringAndSize(const char* s, Py_ssize_t len) {
+    if (len < 0) {
+        __Pyx_mp_err_set_msg(&mp_type_ValueError, MP_ERROR_TEXT("negative size"));
+        return NULL;
+    }
+    if (s == NULL) {
+        return mp_obj_new_bytes(NULL, 0);
+    }
+    return mp_obj_new_bytes((const byte*)s, (size_t)len);
+}
+
+static inline char* PyBytes_AsString(PyObject* obj) {
+    if (mp_obj_is_type(obj, &mp_type_bytes)) {
+        mp_buffer_info_t bufinfo;
+        mp_get_buffer_raise(obj, &bufinfo, MP_BUFFER_READ);
+        return (char*)bufinfo.buf;
+    }
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected bytes"));
+    return NULL;
+}
+
+static inline Py_ssize_t PyBytes_Size(PyObject* obj) {
+    if (mp_obj_is_type(obj, &mp_type_bytes)) {
+        size_t len;
+        mp_obj_str_get_data(obj, &len);
+        return (Py_ssize_t)len;
+    }
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected bytes"));
+    return -1;
+}
+
+// PyBytes_AsStringAndSize: Both values from one lookup of the bytes object.
+static inline int PyBytes_AsStringAndSize(PyObject* obj, char** buffer, Py_ssize_t* length) {
+    if (!mp_obj_is_type(obj, &mp_type_bytes)) {
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected bytes"));
+        return -1;
+    }
+    size_t len;
+    *buffer = (char*)mp_obj_str_get_data(obj, &len);
+    if (length != NULL) {
+        *length = (Py_ssize_t)len;
+    }
+    return 0;
+}
+
+#define PyBytes_GET_SIZE(obj) PyBytes_Size(obj)
+#define PyBytes_AS_STRING(obj) PyBytes_AsString(obj)
+
+// ---------------------
+// Bytearray Operations
+// ---------------------
+static inline PyObject* PyByteArray_FromObject(PyObject* obj) {
+    mp_obj_t bytearray_func = mp_load_global(MP_QSTR_bytearray);
+    return mp_call_function_1(bytearray_func, obj);
+}
+
+static inline PyObject* PyByteArray_FromStringAndSize(const char* s, Py_ssize_t len) {
+    PyObject* bytes = PyBytes_FromStringAndSize(s, len);
+    if (bytes == NULL) {
+        return NULL;
+    }
+    return PyByteArray_FromObject(bytes);
+}
+
+static inline char* PyByteArray_AsString(PyObject* obj) {
+    if (mp_obj_is_type(obj, &mp_type_bytearray)) {
+        mp_buffer_info_t bufinfo;
+        mp_get_buffer_raise(obj, &bufinfo, MP_BUFFER_READ);
+        return (char*)bufinfo.buf;
+    }
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected bytearray"));
+    return NULL;
+}
+
+static inline Py_ssize_t PyByteArray_Size(PyObject* obj) {
+    if (mp_obj_is_type(obj, &mp_type_bytearray)) {
+        mp_buffer_info_t bufinfo;
+        mp_get_buffer_raise(obj, &bufinfo, MP_BUFFER_READ);
+        return (Py_ssize_t)bufinfo.len;
+    }
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected bytearray"));
+    return -1;
+}
+
+// ---------------------
+// Additional Type Checking for Bytes
+// ---------------------
 #define PyBytes_Check(obj) mp_obj_is_type(obj, &mp_type_bytes)
 #define PyByteArray_Check(obj) mp_obj_is_type(obj, &mp_type_bytearray)
 #define PyMemoryView_Check(obj) mp_obj_is_type(obj, &mp_type_memoryview)
@@ -597,15 +1747,42 @@ static inline Py_ssize_t PyByteArray_Size(PyObject* obj) {
 // ============================================================
 // Numeric Operations
 // ============================================================
+// Both operands small ints: compute inline and only fall back to
+// mp_binary_op on overflow or for any other operand types.
+#define __Pyx_BothSmallInt(a, b) (mp_obj_is_small_int(a) && mp_obj_is_small_int(b))
+
 static inline PyObject* PyNumber_Add(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        // Small ints are at least one bit narrower than mp_int_t, so the sum can't wrap.
+        mp_int_t r = MP_OBJ_SMALL_INT_VALUE(a) + MP_OBJ_SMALL_INT_VALUE(b);
+        if (MP_SMALL_INT_FITS(r)) {
+            return MP_OBJ_NEW_SMALL_INT(r);
+        }
+    }
     return mp_binary_op(MP_BINARY_OP_ADD, a, b);
 }
 
 static inline PyObject* PyNumber_Subtract(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        mp_int_t r = MP_OBJ_SMALL_INT_VALUE(a) - MP_OBJ_SMALL_INT_VALUE(b);
+        if (MP_SMALL_INT_FITS(r)) {
+            return MP_OBJ_NEW_SMALL_INT(r);
+        }
+    }
     return mp_binary_op(MP_BINARY_OP_SUBTRACT, a, b);
 }
 
 static inline PyObject* PyNumber_Multiply(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        mp_int_t x = MP_OBJ_SMALL_INT_VALUE(a);
+        mp_int_t y = MP_OBJ_SMALL_INT_VALUE(b);
+        if (!mp_small_int_mul_overflow(x, y)) {
+            mp_int_t r = x * y;
+            if (MP_SMALL_INT_FITS(r)) {
+                return MP_OBJ_NEW_SMALL_INT(r);
+            }
+        }
+    }
     return mp_binary_op(MP_BINARY_OP_MULTIPLY, a, b);
 }
 
@@ -614,13 +1791,215 @@ static inline PyObject* PyNumber_TrueDivide(PyObject* a, PyObject* b) {
 }
 
 static inline PyObject* PyNumber_FloorDivide(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b) && MP_OBJ_SMALL_INT_VALUE(b) != 0) {
+        // Only MIN // -1 can leave the small-int range.
+        mp_int_t r = mp_small_int_floor_divide(MP_OBJ_SMALL_INT_VALUE(a), MP_OBJ_SMALL_INT_VALUE(b));
+        if (MP_SMALL_INT_FITS(r)) {
+            return MP_OBJ_NEW_SMALL_INT(r);
+        }
+    }
+    // Division by zero is raised by mp_binary_op.
     return mp_binary_op(MP_BINARY_OP_FLOOR_DIVIDE, a, b);
 }
 
 static inline PyObject* PyNumber_Remainder(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b) && MP_OBJ_SMALL_INT_VALUE(b) != 0) {
+        return MP_OBJ_NEW_SMALL_INT(mp_small_int_modulo(MP_OBJ_SMALL_INT_VALUE(a), MP_OBJ_SMALL_INT_VALUE(b)));
+    }
     return mp_binary_op(MP_BINARY_OP_MODULO, a, b);
 }
 
+static inline PyObject* PyNumber_And(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        return MP_OBJ_NEW_SMALL_INT(MP_OBJ_SMALL_INT_VALUE(a) & MP_OBJ_SMALL_INT_VALUE(b));
+    }
+    return mp_binary_op(MP_BINARY_OP_AND, a, b);
+}
+
+static inline PyObject* PyNumber_Or(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        return MP_OBJ_NEW_SMALL_INT(MP_OBJ_SMALL_INT_VALUE(a) | MP_OBJ_SMALL_INT_VALUE(b));
+    }
+    return mp_binary_op(MP_BINARY_OP_OR, a, b);
+}
+
+static inline PyObject* PyNumber_Xor(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        return MP_OBJ_NEW_SMALL_INT(MP_OBJ_SMALL_INT_VALUE(a) ^ MP_OBJ_SMALL_INT_VALUE(b));
+    }
+    return mp_binary_op(MP_BINARY_OP_XOR, a, b);
+}
+
+static inline PyObject* PyNumber_Lshift(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        mp_int_t x = MP_OBJ_SMALL_INT_VALUE(a);
+        mp_int_t y = MP_OBJ_SMALL_INT_VALUE(b);
+        if (y >= 0 && y < (mp_int_t)(sizeof(mp_int_t) * 8 - 1)) {
+            mp_int_t r = (mp_int_t)((mp_uint_t)x << y);
+            if ((r >> y) == x && MP_SMALL_INT_FITS(r)) {
+                return MP_OBJ_NEW_SMALL_INT(r);
+            }
+        }
+    }
+    // Negative shift counts raise ValueError inside mp_binary_op.
+    return mp_binary_op(MP_BINARY_OP_LSHIFT, a, b);
+}
+
+static inline PyObject* PyNumber_Rshift(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b) && MP_OBJ_SMALL_INT_VALUE(b) >= 0) {
+        mp_int_t y = MP_OBJ_SMALL_INT_VALUE(b);
+        if (y > (mp_int_t)(sizeof(mp_int_t) * 8 - 1)) {
+            y = sizeof(mp_int_t) * 8 - 1;
+        }
+        return MP_OBJ_NEW_SMALL_INT(MP_OBJ_SMALL_INT_VALUE(a) >> y);
+    }
+    return mp_binary_op(MP_BINARY_OP_RSHIFT, a, b);
+}
+
+// PyNumber_Power: Square-and-multiply for small ints with a non-negative exponent.
+static inline PyObject* PyNumber_Power(PyObject* a, PyObject* b, PyObject* c) {
+    if (c != Py_None && c != NULL) {
+        mp_obj_t args[3] = { a, b, c };
+        return mp_call_function_n_kw(MP_OBJ_FROM_PTR(&mp_builtin_pow_obj), 3, 0, args);
+    }
+    if (__Pyx_BothSmallInt(a, b) && MP_OBJ_SMALL_INT_VALUE(b) >= 0) {
+        mp_int_t base = MP_OBJ_SMALL_INT_VALUE(a);
+        mp_int_t exp = MP_OBJ_SMALL_INT_VALUE(b);
+        mp_int_t r = 1;
+        for (;;) {
+            if (exp & 1) {
+                if (mp_small_int_mul_overflow(r, base)) {
+                    goto slow;
+                }
+                r *= base;
+            }
+            exp >>= 1;
+            if (exp == 0) {
+                break;
+            }
+            if (mp_small_int_mul_overflow(base, base)) {
+                goto slow;
+            }
+            base *= base;
+        }
+        if (MP_SMALL_INT_FITS(r)) {
+            return MP_OBJ_NEW_SMALL_INT(r);
+        }
+    }
+slow:
+    return mp_binary_op(MP_BINARY_OP_POWER, a, b);
+}
+
+// ---------------------
+// In-Place Operations
+// ---------------------
+// Map to MicroPython's MP_BINARY_OP_INPLACE_* so mutable objects are updated
+// rather than rebuilt. list += list/tuple and bytearray += bytes/bytearray
+// extend directly with geometric growth.
+static inline PyObject* PyNumber_InPlaceAdd(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        return PyNumber_Add(a, b);
+    }
+    if (mp_obj_is_type(a, &mp_type_list)
+        && (mp_obj_is_type(b, &mp_type_list) || mp_obj_is_type(b, &mp_type_tuple))) {
+        size_t n;
+        mp_obj_t* items;
+        mp_obj_get_array(b, &n, &items);
+        __Pyx_mp_list_extend_items(MP_OBJ_TO_PTR(a), n, items);
+        return a;
+    }
+    if (mp_obj_is_type(a, &mp_type_bytearray)
+        && (mp_obj_is_type(b, &mp_type_bytes) || mp_obj_is_type(b, &mp_type_bytearray))) {
+        mp_buffer_info_t bufinfo;
+        mp_get_buffer_raise(b, &bufinfo, MP_BUFFER_READ);
+        __Pyx_mp_bytearray_extend_bytes(MP_OBJ_TO_PTR(a), bufinfo.buf, bufinfo.len);
+        return a;
+    }
+    return mp_binary_op(MP_BINARY_OP_INPLACE_ADD, a, b);
+}
+
+static inline PyObject* PyNumber_InPlaceSubtract(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        return PyNumber_Subtract(a, b);
+    }
+    return mp_binary_op(MP_BINARY_OP_INPLACE_SUBTRACT, a, b);
+}
+
+static inline PyObject* PyNumber_InPlaceMultiply(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        return PyNumber_Multiply(a, b);
+    }
+    return mp_binary_op(MP_BINARY_OP_INPLACE_MULTIPLY, a, b);
+}
+
+static inline PyObject* PyNumber_InPlaceTrueDivide(PyObject* a, PyObject* b) {
+    return mp_binary_op(MP_BINARY_OP_INPLACE_TRUE_DIVIDE, a, b);
+}
+
+static inline PyObject* PyNumber_InPlaceFloorDivide(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        return PyNumber_FloorDivide(a, b);
+    }
+    return mp_binary_op(MP_BINARY_OP_INPLACE_FLOOR_DIVIDE, a, b);
+}
+
+static inline PyObject* PyNumber_InPlaceRemainder(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        return PyNumber_Remainder(a, b);
+    }
+    return mp_binary_op(MP_BINARY_OP_INPLACE_MODULO, a, b);
+}
+
+static inline PyObject* PyNumber_InPlacePower(PyObject* a, PyObject* b, PyObject* c) {
+    if (__Pyx_BothSmallInt(a, b) || (c != Py_None && c != NULL)) {
+        return PyNumber_Power(a, b, c);
+    }
+    return mp_binary_op(MP_BINARY_OP_INPLACE_POWER, a, b);
+}
+
+static inline PyObject* PyNumber_InPlaceLshift(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        return PyNumber_Lshift(a, b);
+    }
+    return mp_binary_op(MP_BINARY_OP_INPLACE_LSHIFT, a, b);
+}
+
+static inline PyObject* PyNumber_InPlaceRshift(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        return PyNumber_Rshift(a, b);
+    }
+    return mp_binary_op(MP_BINARY_OP_INPLACE_RSHIFT, a, b);
+}
+
+static inline PyObject* PyNumber_InPlaceAnd(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        return PyNumber_And(a, b);
+    }
+    return mp_binary_op(MP_BINARY_OP_INPLACE_AND, a, b);
+}
+
+static inline PyObject* PyNumber_InPlaceOr(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        return PyNumber_Or(a, b);
+    }
+    return mp_binary_op(MP_BINARY_OP_INPLACE_OR, a, b);
+}
+
+static inline PyObject* PyNumber_InPlaceXor(PyObject* a, PyObject* b) {
+    if (__Pyx_BothSmallInt(a, b)) {
+        return PyNumber_Xor(a, b);
+    }
+    return mp_binary_op(MP_BINARY_OP_INPLACE_XOR, a, b);
+}
+
+static inline PyObject* PyNumber_Invert(PyObject* obj) {
+    if (mp_obj_is_small_int(obj)) {
+        // ~x == -x - 1 always stays within the small-int range.
+        return MP_OBJ_NEW_SMALL_INT(~MP_OBJ_SMALL_INT_VALUE(obj));
+    }
+    return mp_unary_op(MP_UNARY_OP_INVERT, obj);
+}
+
 static inline PyObject* PyNumber_Negative(PyObject* obj) {
     return mp_unary_op(MP_UNARY_OP_NEGATIVE, obj);
 }
@@ -639,23 +2018,80 @@ static inline PyObject* PyNumber_Absolute(PyObject* obj) {
 #define Py_GT 4
 #define Py_GE 5
 
+static const mp_binary_op_t __Pyx_richcmp_ops[6] = {
+    MP_BINARY_OP_LESS_THAN,
+    MP_BINARY_OP_LESS_THAN_OR_EQUAL,
+    MP_BINARY_OP_EQUAL,
+    MP_BINARY_OP_NOT_EQUAL,
+    MP_BINARY_OP_MORE,
+    MP_BINARY_OP_MORE_EQUAL,
+};
+
+// For each op, bit (c + 1) is set if a three-way result c (-1, 0, 1) satisfies it.
+static const unsigned char __Pyx_richcmp_masks[6] = {
+    0x1, // Py_LT
+    0x3, // Py_LE
+    0x2, // Py_EQ
+    0x5, // Py_NE
+    0x4, // Py_GT
+    0x6, // Py_GE
+};
+
+// Compare two C numbers without boxing. Returns -1 if the operands are not
+// both small ints or both floats, so the caller takes the generic path.
+static inline int __Pyx_RichCompare_Unboxed(PyObject* a, PyObject* b, int op) {
+    if (mp_obj_is_small_int(a) && mp_obj_is_small_int(b)) {
+        mp_int_t x = MP_OBJ_SMALL_INT_VALUE(a);
+        mp_int_t y = MP_OBJ_SMALL_INT_VALUE(b);
+        int c = (x > y) - (x < y);
+        return (__Pyx_richcmp_masks[op] >> (c + 1)) & 1;
+    }
+    #if MICROPY_PY_BUILTINS_FLOAT
+    if (mp_obj_is_float(a) && mp_obj_is_float(b)) {
+        mp_float_t x = mp_obj_float_get(a);
+        mp_float_t y = mp_obj_float_get(b);
+        if (x != x || y != y) {
+            // NaN is unordered: only != holds.
+            return op == Py_NE;
+        }
+        int c = (x > y) - (x < y);
+        return (__Pyx_richcmp_masks[op] >> (c + 1)) & 1;
+    }
+    #endif
+    return -1;
+}
+
 static inline PyObject* PyObject_RichCompare(PyObject* a, PyObject* b, int op) {
-    mp_binary_op_t mp_op;
-    switch (op) {
-        case Py_LT: mp_op = MP_BINARY_OP_LESS_THAN; break;
-        case Py_LE: mp_op = MP_BINARY_OP_LESS_THAN_OR_EQUAL; break;
-        case Py_EQ: mp_op = MP_BINARY_OP_EQUAL; break;
-        case Py_NE: mp_op = MP_BINARY_OP_NOT_EQUAL; break;
-        case Py_GT: mp_op = MP_BINARY_OP_GREATER_THAN; break;
-        case Py_GE: mp_op = MP_BINARY_OP_GREATER_THAN_OR_EQUAL; break;
-        default: mp_raise_ValueError(MP_ERROR_TEXT("invalid comparison operator")); return NULL;
+    if ((unsigned)op > Py_GE) {
+        __Pyx_mp_err_set_msg(&mp_type_ValueError, MP_ERROR_TEXT("invalid comparison operator"));
+        return NULL;
+    }
+    int r = __Pyx_RichCompare_Unboxed(a, b, op);
+    if (r >= 0) {
+        return mp_obj_new_bool(r);
     }
-    return mp_binary_op(mp_op, a, b);
+    return mp_binary_op(__Pyx_richcmp_ops[op], a, b);
 }
 
 static inline int PyObject_RichCompareBool(PyObject* a, PyObject* b, int op) {
-    PyObject* result = PyObject_RichCompare(a, b, op);
-    return mp_obj_is_true(result);
+    // Like CPython, identical objects are taken to be equal.
+    if (a == b) {
+        if (op == Py_EQ) {
+            return 1;
+        }
+        if (op == Py_NE) {
+            return 0;
+        }
+    }
+    if ((unsigned)op > Py_GE) {
+        __Pyx_mp_err_set_msg(&mp_type_ValueError, MP_ERROR_TEXT("invalid comparison operator"));
+        return -1;
+    }
+    int r = __Pyx_RichCompare_Unboxed(a, b, op);
+    if (r >= 0) {
+        return r;
+    }
+    return mp_obj_is_true(mp_binary_op(__Pyx_richcmp_ops[op], a, b));
 }
 
 // ============================================================
@@ -678,10 +2114,10 @@ static inline int PyObject_AsReadBuffer(PyObject* obj, const void** buf, Py_ssiz
     mp_buffer_info_t bufinfo;
     if (mp_get_buffer(obj, &bufinfo, MP_BUFFER_READ)) {
         *buf = bufinfo.buf;
-        *len = bufinfo.len;
+        *len = (Py_ssize_t)bufinfo.len;
         return 0;
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("object does not support buffer protocol"));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("object does not support buffer protocol"));
     return -1;
 }
 
@@ -689,10 +2125,10 @@ static inline int PyObject_AsWriteBuffer(PyObject* obj, void** buf, Py_ssize_t*
     mp_buffer_info_t bufinfo;
     if (mp_get_buffer(obj, &bufinfo, MP_BUFFER_RW)) {
         *buf = bufinfo.buf;
-        *len = bufinfo.len;
+        *len = (Py_ssize_t)bufinfo.len;
         return 0;
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("object does not support writable buffer"));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("object does not support writable buffer"));
     return -1;
 }
 
@@ -704,29 +2140,190 @@ static inline PyObject* PyMemoryView_FromObject(PyObject* obj) {
     mp_obj_t args[1] = { obj };
     return mp_call_function_n_kw(mp_load_global(MP_QSTR_memoryview), 1, 0, args);
 }
-
-#define PyMemoryView_GET_BUFFER(obj, buf) \
-    do { \
-        mp_buffer_info_t bufinfo; \
-        mp_get_buffer_raise(obj, &bufinfo, MP_BUFFER_READ); \
-        (buf)->buf = bufinfo.buf; \
-        (buf)->len = bufinfo.len; \
-        (buf)->readonly = 1; \
-        (buf)->format = NULL; \
-        (buf)->ndim = 1; \
-        (buf)->shape = &(buf)->len; \
-        (buf)->strides = NULL; \
-        (buf)->suboffsets = NULL; \
-        (buf)->itemsize = 1; \
-        (buf)->internal = NULL; \
-    } while (0)
+
+#define PyMemoryView_GET_BUFFER(obj, buf) \
+    do { \
+        mp_buffer_info_t bufinfo; \
+        int writable = mp_get_buffer(obj, &bufinfo, MP_BUFFER_RW); \
+        if (!writable) { \
+            mp_get_buffer_raise(obj, &bufinfo, MP_BUFFER_READ); \
+        } \
+        (buf)->buf = bufinfo.buf; \
+        (buf)->len = (Py_ssize_t)bufinfo.len; \
+        (buf)->readonly = !writable; \
+        (buf)->format = NULL; \
+        (buf)->ndim = 1; \
+        (buf)->shape = &(buf)->len; \
+        (buf)->strides = NULL; \
+        (buf)->suboffsets = NULL; \
+        (buf)->itemsize = 1; \
+        (buf)->internal = NULL; \
+    } while (0)
+
+// PyObject_GetBuffer / PyBuffer_Release: Used by Cython typed memoryviews.
+// The view points straight at the object's storage; nothing is copied.
+#define PyBUF_SIMPLE 0
+#define PyBUF_WRITABLE 0x0001
+#define PyBUF_FORMAT 0x0004
+#define PyBUF_ND 0x0008
+#define PyBUF_STRIDES (0x0010 | PyBUF_ND)
+
+static inline int PyObject_GetBuffer(PyObject* obj, Py_buffer* view, int flags) {
+    mp_buffer_info_t bufinfo;
+    int writable = mp_get_buffer(obj, &bufinfo, MP_BUFFER_RW);
+    if (!writable) {
+        if (flags & PyBUF_WRITABLE) {
+            __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("object does not support writable buffer"));
+            return -1;
+        }
+        mp_get_buffer_raise(obj, &bufinfo, MP_BUFFER_READ);
+    }
+    view->buf = bufinfo.buf;
+    view->len = (Py_ssize_t)bufinfo.len;
+    view->readonly = !writable;
+    view->format = (flags & PyBUF_FORMAT) ? (char*)"B" : NULL;
+    view->ndim = 1;
+    view->shape = (flags & PyBUF_ND) ? &view->len : NULL;
+    view->strides = NULL;
+    view->suboffsets = NULL;
+    view->itemsize = 1;
+    view->internal = NULL;
+    return 0;
+}
+
+static inline void PyBuffer_Release(Py_buffer* view) {
+    view->buf = NULL;
+}
+
+// ---------------------
+// Memory-Mapped Buffers (unix port)
+// ---------------------
+// A minimal buffer object backed by mmap(). It lives outside the GC heap, so
+// PyObject_AsReadBuffer, PyObject_GetBuffer and typed memoryviews get a
+// pointer straight into the mapping. The type is named by MP_QSTR_mmap, which
+// a prebuilt MicroPython lacks: it comes from the generated cython_qstrdefs.h,
+// so this needs CYTHON_QSTRS=1 (which defines __PYX_MP_QSTRDEFS).
+// MicroPython memoryviews do not keep their exporter alive and PyBuffer_Release
+// is a no-op, so a view can outlive the object; the mapping is therefore only
+// ever unmapped by an explicit close(), never by a GC finaliser. Close it once
+// no view or Py_buffer uses it any more; an unclosed mapping is leaked.
+#ifndef __PYX_MP_QSTRDEFS
+#define __PYX_MP_QSTRDEFS 0
+#endif
+
+#if (defined(__unix__) || defined(__APPLE__)) && __PYX_MP_QSTRDEFS
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct _mp_obj_mmap_buffer_t {
+    mp_obj_base_t base;
+    void* addr;
+    size_t len;
+    bool writable;
+} mp_obj_mmap_buffer_t;
+
+static mp_int_t mmap_buffer_get_buffer(mp_obj_t self_in, mp_buffer_info_t* bufinfo, mp_uint_t flags) {
+    mp_obj_mmap_buffer_t* self = MP_OBJ_TO_PTR(self_in);
+    if (self->addr == NULL || ((flags & MP_BUFFER_WRITE) && !self->writable)) {
+        return 1;
+    }
+    bufinfo->buf = self->addr;
+    bufinfo->len = self->len;
+    bufinfo->typecode = 'B';
+    return 0;
+}
+
+static mp_obj_t mmap_buffer_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
+    mp_obj_mmap_buffer_t* self = MP_OBJ_TO_PTR(self_in);
+    switch (op) {
+        case MP_UNARY_OP_LEN: return mp_obj_new_int_from_uint(self->len);
+        case MP_UNARY_OP_BOOL: return mp_obj_new_bool(self->len != 0);
+        default: return MP_OBJ_NULL;
+    }
+}
+
+static mp_obj_t mmap_buffer_close(mp_obj_t self_in) {
+    mp_obj_mmap_buffer_t* self = MP_OBJ_TO_PTR(self_in);
+    if (self->addr != NULL) {
+        munmap(self->addr, self->len);
+        self->addr = NULL;
+        self->len = 0;
+    }
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(mmap_buffer_close_obj, mmap_buffer_close);
+
+static const mp_rom_map_elem_t mmap_buffer_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_close), MP_ROM_PTR(&mmap_buffer_close_obj) },
+};
+static MP_DEFINE_CONST_DICT(mmap_buffer_locals_dict, mmap_buffer_locals_dict_table);
+
+static MP_DEFINE_CONST_OBJ_TYPE(
+    mp_type_mmap_buffer,
+    MP_QSTR_mmap,
+    MP_TYPE_FLAG_NONE,
+    unary_op, mmap_buffer_unary_op,
+    buffer, mmap_buffer_get_buffer,
+    locals_dict, &mmap_buffer_locals_dict
+    );
+
+#define PyMMapBuffer_Check(obj) mp_obj_is_type(obj, &mp_type_mmap_buffer)
+
+// PyMMapBuffer_Open: Map a whole file read-only (writable == 0) or shared read-write.
+static inline PyObject* PyMMapBuffer_Open(const char* path, int writable) {
+    int fd = open(path, writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        __Pyx_mp_err_set(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(errno)));
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        int err = errno;
+        close(fd);
+        __Pyx_mp_err_set(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(err)));
+        return NULL;
+    }
+    void* addr = NULL;
+    size_t len = (size_t)st.st_size;
+    if (len > 0) {
+        addr = mmap(NULL, len, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            int err = errno;
+            close(fd);
+            __Pyx_mp_err_set(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(err)));
+            return NULL;
+        }
+    }
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+    mp_obj_mmap_buffer_t* self = m_new_obj(mp_obj_mmap_buffer_t);
+    self->base.type = &mp_type_mmap_buffer;
+    self->addr = addr;
+    self->len = len;
+    self->writable = writable != 0;
+    return MP_OBJ_FROM_PTR(self);
+}
+
+// PyMMapBuffer_Close: Unmap; later buffer requests on the object fail.
+static inline int PyMMapBuffer_Close(PyObject* obj) {
+    if (!PyMMapBuffer_Check(obj)) {
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected mmap buffer"));
+        return -1;
+    }
+    mmap_buffer_close(obj);
+    return 0;
+}
+#endif
 
 // ============================================================
 // Argument Parsing
 // ============================================================
 static int PyArg_ParseTuple(PyObject* tuple, const char* format, ...) {
     if (!mp_obj_is_type(tuple, &mp_type_tuple)) {
-        mp_raise_TypeError(MP_ERROR_TEXT("expected tuple"));
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected tuple"));
         return 0;
     }
     va_list args;
@@ -740,17 +2337,27 @@ static int PyArg_ParseTuple(PyObject* tuple, const char* format, ...) {
             case 'i': { 
                 int* ptr = va_arg(args, int*);
                 if (!mp_obj_is_int(item)) { 
-                    mp_raise_TypeError(MP_ERROR_TEXT("expected int")); 
+                    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected int")); 
                     va_end(args); 
                     return 0; 
                 }
                 *ptr = mp_obj_get_int(item); 
                 break; 
             }
+            case 'n': {
+                Py_ssize_t* ptr = va_arg(args, Py_ssize_t*);
+                if (!mp_obj_is_int(item)) {
+                    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected int"));
+                    va_end(args);
+                    return 0;
+                }
+                *ptr = mp_obj_get_int(item);
+                break;
+            }
             case 's': { 
                 const char** ptr = va_arg(args, const char**);
                 if (!mp_obj_is_str(item)) { 
-                    mp_raise_TypeError(MP_ERROR_TEXT("expected str")); 
+                    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected str")); 
                     va_end(args); 
                     return 0; 
                 }
@@ -763,7 +2370,7 @@ static int PyArg_ParseTuple(PyObject* tuple, const char* format, ...) {
                 break; 
             }
             default: 
-                mp_raise_ValueError(MP_ERROR_TEXT("unsupported format specifier")); 
+                __Pyx_mp_err_set_msg(&mp_type_ValueError, MP_ERROR_TEXT("unsupported format specifier")); 
                 va_end(args); 
                 return 0;
         }
@@ -771,7 +2378,7 @@ static int PyArg_ParseTuple(PyObject* tuple, const char* format, ...) {
         arg_index++;
     }
     if (*fmt != '\0' || arg_index < tuple_len) { 
-        mp_raise_ValueError(MP_ERROR_TEXT("argument mismatch")); 
+        __Pyx_mp_err_set_msg(&mp_type_ValueError, MP_ERROR_TEXT("argument mismatch")); 
         va_end(args); 
         return 0; 
     }
@@ -790,7 +2397,7 @@ static inline Py_ssize_t PyTuple_Size(PyObject* tuple) {
     if (mp_obj_is_type(tuple, &mp_type_tuple)) {
         return mp_obj_tuple_get_len(tuple);
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected tuple"));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected tuple"));
     return -1;
 }
 
@@ -798,7 +2405,7 @@ static inline PyObject* PyTuple_GetItem(PyObject* tuple, Py_ssize_t i) {
     if (mp_obj_is_type(tuple, &mp_type_tuple)) {
         return mp_obj_tuple_get_item(tuple, (size_t)i);
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected tuple"));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected tuple"));
     return NULL;
 }
 
@@ -806,7 +2413,7 @@ static inline Py_ssize_t PyList_Size(PyObject* list) {
     if (mp_obj_is_type(list, &mp_type_list)) {
         return mp_obj_list_get_len(list);
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected list"));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected list"));
     return -1;
 }
 
@@ -814,15 +2421,463 @@ static inline PyObject* PyList_GetItem(PyObject* list, Py_ssize_t i) {
     if (mp_obj_is_type(list, &mp_type_list)) {
         return mp_obj_list_get_item(list, (size_t)i);
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected list"));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected list"));
     return NULL;
 }
 
+// ---------------------
+// List Growth
+// ---------------------
+// These work on mp_obj_list_t directly: the item is stored into spare
+// capacity when there is some, otherwise the list grows geometrically
+// (see __Pyx_mp_list_reserve).
+static inline int PyList_Append(PyObject* list, PyObject* item) {
+    if (!mp_obj_is_type(list, &mp_type_list)) {
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected list"));
+        return -1;
+    }
+    mp_obj_list_t* self = MP_OBJ_TO_PTR(list);
+    if (self->len >= self->alloc) {
+        __Pyx_mp_list_reserve(self, 1);
+    }
+    self->items[self->len++] = item;
+    return 0;
+}
+
+#define __Pyx_PyList_Append(list, item) PyList_Append(list, item)
+#define __Pyx_ListComp_Append(list, item) PyList_Append(list, item)
+
+// __Pyx_PyList_FromTemplate: List display of constants from its ROM tuple template
+// (see modify_includes.py --rom-constants): one list allocation, one memcpy.
+static inline PyObject* __Pyx_PyList_FromTemplate(PyObject* tmpl) {
+    const mp_obj_tuple_t* t = MP_OBJ_TO_PTR(tmpl);
+    PyObject* list = mp_obj_new_list(t->len, NULL);
+    memcpy(((mp_obj_list_t*)MP_OBJ_TO_PTR(list))->items, t->items, t->len * sizeof(mp_obj_t));
+    return list;
+}
+
+static inline int PyList_Insert(PyObject* list, Py_ssize_t index, PyObject* item) {
+    if (!mp_obj_is_type(list, &mp_type_list)) {
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected list"));
+        return -1;
+    }
+    mp_obj_list_t* self = MP_OBJ_TO_PTR(list);
+    // Out-of-range indices clamp to the ends, as list.insert does.
+    if (index < 0) {
+        index += (Py_ssize_t)self->len;
+        if (index < 0) {
+            index = 0;
+        }
+    }
+    if ((size_t)index > self->len) {
+        index = (Py_ssize_t)self->len;
+    }
+    if (self->len >= self->alloc) {
+        __Pyx_mp_list_reserve(self, 1);
+    }
+    memmove(self->items + index + 1, self->items + index, (self->len - (size_t)index) * sizeof(mp_obj_t));
+    self->items[index] = item;
+    self->len++;
+    return 0;
+}
+
+static inline int PyList_Extend(PyObject* list, PyObject* iterable) {
+    if (!mp_obj_is_type(list, &mp_type_list)) {
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected list"));
+        return -1;
+    }
+    mp_obj_list_t* self = MP_OBJ_TO_PTR(list);
+    if (mp_obj_is_type(iterable, &mp_type_list) || mp_obj_is_type(iterable, &mp_type_tuple)) {
+        size_t n;
+        mp_obj_t* items;
+        mp_obj_get_array(iterable, &n, &items);
+        __Pyx_mp_list_extend_items(self, n, items);
+        return 0;
+    }
+    mp_obj_t len_obj = mp_obj_len_maybe(iterable);
+    if (len_obj != MP_OBJ_NULL) {
+        __Pyx_mp_list_reserve(self, (size_t)mp_obj_get_int(len_obj));
+    }
+    __Pyx_mp_iter_t it;
+    __Pyx_mp_iter_init(&it, iterable);
+    PyObject* item;
+    while ((item = __Pyx_mp_iter_next(&it)) != NULL) {
+        PyList_Append(list, item);
+    }
+    return 0;
+}
+
+// ---------------------
+// Slicing
+// ---------------------
+// Slices of list, tuple, bytes, bytearray and str are taken with C indices,
+// clamped inline, and copied into a new object of exactly the right size.
+// Other types build a slice object and go through mp_obj_subscr.
+
+// Clamp [start, stop) to a sequence of length len. With wraparound, negative
+// indices count from the end; without it they are treated as 0.
+static inline void __Pyx_mp_clamp_slice(size_t len, Py_ssize_t* start, Py_ssize_t* stop, int wraparound) {
+    Py_ssize_t n = (Py_ssize_t)len;
+    if (*start < 0) {
+        *start = wraparound ? (*start + n < 0 ? 0 : *start + n) : 0;
+    } else if (*start > n) {
+        *start = n;
+    }
+    if (*stop < 0) {
+        *stop = wraparound ? (*stop + n < 0 ? 0 : *stop + n) : 0;
+    } else if (*stop > n) {
+        *stop = n;
+    }
+    if (*stop < *start) {
+        *stop = *start;
+    }
+}
+
+// Returns MP_OBJ_NULL if obj is not one of the directly sliceable types.
+static inline PyObject* __Pyx_mp_slice_fast(PyObject* obj, Py_ssize_t start, Py_ssize_t stop, int wraparound) {
+    if (mp_obj_is_type(obj, &mp_type_list) || mp_obj_is_type(obj, &mp_type_tuple)) {
+        size_t len;
+        mp_obj_t* items;
+        mp_obj_get_array(obj, &len, &items);
+        __Pyx_mp_clamp_slice(len, &start, &stop, wraparound);
+        if (mp_obj_is_type(obj, &mp_type_list)) {
+            return mp_obj_new_list((size_t)(stop - start), items + start);
+        }
+        return mp_obj_new_tuple((size_t)(stop - start), items + start);
+    }
+    if (mp_obj_is_type(obj, &mp_type_bytes) || mp_obj_is_type(obj, &mp_type_bytearray)) {
+        mp_buffer_info_t bufinfo;
+        mp_get_buffer_raise(obj, &bufinfo, MP_BUFFER_READ);
+        __Pyx_mp_clamp_slice(bufinfo.len, &start, &stop, wraparound);
+        const byte* data = (const byte*)bufinfo.buf + start;
+        if (mp_obj_is_type(obj, &mp_type_bytes)) {
+            return mp_obj_new_bytes(data, (size_t)(stop - start));
+        }
+        return mp_obj_new_bytearray((size_t)(stop - start), data);
+    }
+    if (mp_obj_is_str(obj)) {
+        size_t blen;
+        const byte* data = (const byte*)mp_obj_str_get_data(obj, &blen);
+        // Indices are codepoints; map them to byte offsets.
+        __Pyx_mp_clamp_slice(__Pyx_mp_str_char_len(obj), &start, &stop, wraparound);
+        size_t b_start = __Pyx_mp_str_byte_offset(obj, (size_t)start);
+        size_t b_stop = __Pyx_mp_str_byte_offset(obj, (size_t)stop);
+        return mp_obj_new_str((const char*)data + b_start, b_stop - b_start);
+    }
+    return MP_OBJ_NULL;
+}
+
+static inline PyObject* __Pyx_mp_new_slice(Py_ssize_t start, Py_ssize_t stop, int has_start, int has_stop) {
+    return mp_obj_new_slice(has_start ? mp_obj_new_int(start) : mp_const_none,
+                            has_stop ? mp_obj_new_int(stop) : mp_const_none,
+                            mp_const_none);
+}
+
+static inline PyObject* PyList_GetSlice(PyObject* list, Py_ssize_t low, Py_ssize_t high) {
+    if (!mp_obj_is_type(list, &mp_type_list)) {
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected list"));
+        return NULL;
+    }
+    return __Pyx_mp_slice_fast(list, low, high, 0);
+}
+
+static inline PyObject* PySequence_GetSlice(PyObject* seq, Py_ssize_t i1, Py_ssize_t i2) {
+    PyObject* result = __Pyx_mp_slice_fast(seq, i1, i2, 1);
+    if (result != MP_OBJ_NULL) {
+        return result;
+    }
+    return mp_obj_subscr(seq, __Pyx_mp_new_slice(i1, i2, 1, 1), MP_OBJ_SENTINEL);
+}
+
+// Resolve Cython's optional object bounds to C indices. Returns 0 if a bound is
+// something other than None or a small int, in which case the caller must use
+// the generic path.
+static inline int __Pyx_mp_slice_bound(PyObject** py_bound, Py_ssize_t* c_bound, int* has_bound) {
+    if (py_bound == NULL || *py_bound == NULL) {
+        return 1;
+    }
+    if (*py_bound == mp_const_none) {
+        *has_bound = 0;
+        return 1;
+    }
+    if (mp_obj_is_small_int(*py_bound)) {
+        *c_bound = MP_OBJ_SMALL_INT_VALUE(*py_bound);
+        *has_bound = 1;
+        return 1;
+    }
+    return 0;
+}
+
+static inline PyObject* __Pyx_PyObject_GetSlice(PyObject* obj, Py_ssize_t cstart, Py_ssize_t cstop,
+                                                PyObject** py_start, PyObject** py_stop, PyObject** py_slice,
+                                                int has_cstart, int has_cstop, int wraparound) {
+    if (py_slice != NULL && *py_slice != NULL) {
+        return mp_obj_subscr(obj, *py_slice, MP_OBJ_SENTINEL);
+    }
+    if (__Pyx_mp_slice_bound(py_start, &cstart, &has_cstart) && __Pyx_mp_slice_bound(py_stop, &cstop, &has_cstop)) {
+        PyObject* result = __Pyx_mp_slice_fast(obj, has_cstart ? cstart : 0,
+                                               has_cstop ? cstop : PY_SSIZE_T_MAX, wraparound);
+        if (result != MP_OBJ_NULL) {
+            return result;
+        }
+        return mp_obj_subscr(obj, __Pyx_mp_new_slice(cstart, cstop, has_cstart, has_cstop), MP_OBJ_SENTINEL);
+    }
+    mp_obj_t slice = mp_obj_new_slice(
+        (py_start && *py_start) ? *py_start : (has_cstart ? mp_obj_new_int(cstart) : mp_const_none),
+        (py_stop && *py_stop) ? *py_stop : (has_cstop ? mp_obj_new_int(cstop) : mp_const_none),
+        mp_const_none);
+    return mp_obj_subscr(obj, slice, MP_OBJ_SENTINEL);
+}
+
+// ---------------------
+// Slice Assignment
+// ---------------------
+// list[a:b] = list/tuple and bytearray[a:b] = bytes-like splice in place:
+// one memmove of the tail and one memcpy of the new items. value == NULL
+// deletes the range.
+static inline int __Pyx_mp_list_set_slice(mp_obj_list_t* self, Py_ssize_t start, Py_ssize_t stop, PyObject* value) {
+    size_t n = 0;
+    mp_obj_t* items = NULL;
+    if (value != NULL) {
+        if (MP_OBJ_TO_PTR(value) == self) {
+            // a[i:j] = a: take a copy first.
+            value = mp_obj_new_tuple(self->len, self->items);
+        }
+        mp_obj_get_array(value, &n, &items);
+    }
+    size_t old = (size_t)(stop - start);
+    if (n > old) {
+        __Pyx_mp_list_reserve(self, n - old);
+    }
+    memmove(self->items + start + n, self->items + stop, (self->len - (size_t)stop) * sizeof(mp_obj_t));
+    memcpy(self->items + start, items, n * sizeof(mp_obj_t));
+    size_t new_len = self->len - old + n;
+    if (new_len < self->len) {
+        // Clear vacated slots so the GC doesn't keep their old items alive.
+        memset(self->items + new_len, 0, (self->len - new_len) * sizeof(mp_obj_t));
+    }
+    self->len = new_len;
+    return 0;
+}
+
+static inline int __Pyx_mp_bytearray_set_slice(mp_obj_array_t* self, Py_ssize_t start, Py_ssize_t stop, PyObject* value) {
+    mp_buffer_info_t bufinfo = { NULL, 0, 'B' };
+    if (value != NULL) {
+        if (MP_OBJ_TO_PTR(value) == self) {
+            value = mp_obj_new_bytes(self->items, self->len);
+        }
+        mp_get_buffer_raise(value, &bufinfo, MP_BUFFER_READ);
+    }
+    size_t n = bufinfo.len;
+    size_t old = (size_t)(stop - start);
+    if (n > old && self->free < n - old) {
+        size_t capacity = self->len + self->free;
+        self->items = m_renew(byte, self->items, capacity, self->len - old + n);
+        self->free = 0;
+    } else if (n > old) {
+        self->free -= n - old;
+    }
+    byte* items = self->items;
+    memmove(items + start + n, items + stop, self->len - (size_t)stop);
+    memcpy(items + start, bufinfo.buf, n);
+    size_t new_len = self->len - old + n;
+    if (n < old) {
+        size_t spare = self->free + (old - n);
+        size_t max_free = ((size_t)1 << MP_OBJ_ARRAY_FREE_SIZE_BITS) - 1;
+        if (spare > max_free) {
+            // More slack than the 'free' bitfield can record: give it back.
+            self->items = m_renew(byte, self->items, self->len + self->free, new_len);
+            spare = 0;
+        }
+        self->free = spare;
+    }
+    self->len = new_len;
+    return 0;
+}
+
+static inline int __Pyx_PyObject_SetSlice(PyObject* obj, PyObject* value, Py_ssize_t cstart, Py_ssize_t cstop,
+                                          PyObject** py_start, PyObject** py_stop, PyObject** py_slice,
+                                          int has_cstart, int has_cstop, int wraparound) {
+    if ((py_slice == NULL || *py_slice == NULL)
+        && __Pyx_mp_slice_bound(py_start, &cstart, &has_cstart) && __Pyx_mp_slice_bound(py_stop, &cstop, &has_cstop)) {
+        Py_ssize_t start = has_cstart ? cstart : 0;
+        Py_ssize_t stop = has_cstop ? cstop : PY_SSIZE_T_MAX;
+        if (mp_obj_is_type(obj, &mp_type_list)
+            && (value == NULL || mp_obj_is_type(value, &mp_type_list) || mp_obj_is_type(value, &mp_type_tuple))) {
+            mp_obj_list_t* self = MP_OBJ_TO_PTR(obj);
+            __Pyx_mp_clamp_slice(self->len, &start, &stop, wraparound);
+            return __Pyx_mp_list_set_slice(self, start, stop, value);
+        }
+        if (mp_obj_is_type(obj, &mp_type_bytearray)
+            && (value == NULL || mp_obj_is_type(value, &mp_type_bytes) || mp_obj_is_type(value, &mp_type_bytearray))) {
+            mp_obj_array_t* self = MP_OBJ_TO_PTR(obj);
+            __Pyx_mp_clamp_slice(self->len, &start, &stop, wraparound);
+            return __Pyx_mp_bytearray_set_slice(self, start, stop, value);
+        }
+    }
+    mp_obj_t slice;
+    if (py_slice != NULL && *py_slice != NULL) {
+        slice = *py_slice;
+    } else {
+        slice = mp_obj_new_slice(
+            (py_start && *py_start) ? *py_start : (has_cstart ? mp_obj_new_int(cstart) : mp_const_none),
+            (py_stop && *py_stop) ? *py_stop : (has_cstop ? mp_obj_new_int(cstop) : mp_const_none),
+            mp_const_none);
+    }
+    mp_obj_subscr(obj, slice, value == NULL ? MP_OBJ_NULL : value);
+    return 0;
+}
+
+// Cython's SliceObject utility, which modify_includes.py drops, also defines this.
+#define __Pyx_PyObject_DelSlice(obj, cstart, cstop, py_start, py_stop, py_slice, has_cstart, has_cstop, wraparound) \
+    __Pyx_PyObject_SetSlice(obj, (PyObject*)NULL, cstart, cstop, py_start, py_stop, py_slice, has_cstart, has_cstop, wraparound)
+
+// PyList_SetSlice: itemlist == NULL deletes the range.
+static inline int PyList_SetSlice(PyObject* list, Py_ssize_t low, Py_ssize_t high, PyObject* itemlist) {
+    if (!mp_obj_is_type(list, &mp_type_list)) {
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected list"));
+        return -1;
+    }
+    return __Pyx_PyObject_SetSlice(list, itemlist, low, high, NULL, NULL, NULL, 1, 1, 0);
+}
+
+// ---------------------
+// List Sorting
+// ---------------------
+// PyList_Sort specialises lists that hold only small ints, only floats or only
+// strs. Small ints are LSD radix-sorted on their values; floats and strs use a
+// stable bottom-up merge sort with an unboxed comparator (memcmp for strs,
+// which matches codepoint order for UTF-8). Both are stable, so equal keys
+// keep their order as with Python's sort. Mixed lists, subclasses and floats
+// containing NaN use MicroPython's list.sort.
+static inline void __Pyx_mp_sort_small_ints(mp_obj_t* items, mp_obj_t* tmp, size_t n) {
+    const mp_uint_t flip = (mp_uint_t)1 << (sizeof(mp_uint_t) * 8 - 1);
+    mp_obj_t* src = items;
+    mp_obj_t* dst = tmp;
+    for (size_t shift = 0; shift < sizeof(mp_uint_t) * 8; shift += 8) {
+        size_t count[256] = {0};
+        for (size_t i = 0; i < n; i++) {
+            mp_uint_t key = (mp_uint_t)MP_OBJ_SMALL_INT_VALUE(src[i]) ^ flip;
+            count[(key >> shift) & 0xFF]++;
+        }
+        // All keys share this byte: the pass would not move anything.
+        if (count[((((mp_uint_t)MP_OBJ_SMALL_INT_VALUE(src[0])) ^ flip) >> shift) & 0xFF] == n) {
+            continue;
+        }
+        size_t pos = 0;
+        for (size_t b = 0; b < 256; b++) {
+            size_t c = count[b];
+            count[b] = pos;
+            pos += c;
+        }
+        for (size_t i = 0; i < n; i++) {
+            mp_uint_t key = (mp_uint_t)MP_OBJ_SMALL_INT_VALUE(src[i]) ^ flip;
+            dst[count[(key >> shift) & 0xFF]++] = src[i];
+        }
+        mp_obj_t* t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != items) {
+        memcpy(items, src, n * sizeof(mp_obj_t));
+    }
+}
+
+#if MICROPY_PY_BUILTINS_FLOAT
+static inline bool __Pyx_mp_float_less(mp_obj_t a, mp_obj_t b) {
+    return mp_obj_float_get(a) < mp_obj_float_get(b);
+}
+#endif
+
+static inline bool __Pyx_mp_str_less(mp_obj_t a, mp_obj_t b) {
+    if (a == b) {
+        return false;
+    }
+    size_t la, lb;
+    const char* da = mp_obj_str_get_data(a, &la);
+    const char* db = mp_obj_str_get_data(b, &lb);
+    int c = memcmp(da, db, la < lb ? la : lb);
+    return c < 0 || (c == 0 && la < lb);
+}
+
+// Stable: an element from the right run is taken only if strictly less.
+static inline void __Pyx_mp_merge_sort(mp_obj_t* items, mp_obj_t* tmp, size_t n, bool (*less)(mp_obj_t, mp_obj_t)) {
+    mp_obj_t* src = items;
+    mp_obj_t* dst = tmp;
+    for (size_t width = 1; width < n; width *= 2) {
+        for (size_t lo = 0; lo < n; lo += 2 * width) {
+            size_t mid = lo + width < n ? lo + width : n;
+            size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+            size_t i = lo, j = mid, k = lo;
+            while (i < mid && j < hi) {
+                dst[k++] = less(src[j], src[i]) ? src[j++] : src[i++];
+            }
+            while (i < mid) {
+                dst[k++] = src[i++];
+            }
+            while (j < hi) {
+                dst[k++] = src[j++];
+            }
+        }
+        mp_obj_t* t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != items) {
+        memcpy(items, src, n * sizeof(mp_obj_t));
+    }
+}
+
+static inline int PyList_Sort(PyObject* list) {
+    if (!mp_obj_is_type(list, &mp_type_list)) {
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected list"));
+        return -1;
+    }
+    mp_obj_list_t* self = MP_OBJ_TO_PTR(list);
+    size_t n = self->len;
+    if (n < 2) {
+        return 0;
+    }
+    mp_obj_t* items = self->items;
+    bool all_int = true, all_float = true, all_str = true;
+    for (size_t i = 0; i < n && (all_int || all_float || all_str); i++) {
+        mp_obj_t o = items[i];
+        all_int = all_int && mp_obj_is_small_int(o);
+        #if MICROPY_PY_BUILTINS_FLOAT
+        if (all_float) {
+            // NaN makes the ordering depend on the algorithm; leave it to list.sort.
+            all_float = mp_obj_is_float(o) && !isnan(mp_obj_float_get(o));
+        }
+        #else
+        all_float = false;
+        #endif
+        all_str = all_str && (mp_obj_is_qstr(o) || mp_obj_is_exact_type(o, &mp_type_str));
+    }
+    if (all_int || all_float || all_str) {
+        mp_obj_t* tmp = m_new(mp_obj_t, n);
+        if (all_int) {
+            __Pyx_mp_sort_small_ints(items, tmp, n);
+        #if MICROPY_PY_BUILTINS_FLOAT
+        } else if (all_float) {
+            __Pyx_mp_merge_sort(items, tmp, n, __Pyx_mp_float_less);
+        #endif
+        } else {
+            __Pyx_mp_merge_sort(items, tmp, n, __Pyx_mp_str_less);
+        }
+        m_del(mp_obj_t, tmp, n);
+        return 0;
+    }
+    mp_map_t kwargs;
+    mp_map_init(&kwargs, 0);
+    mp_obj_list_sort(1, &list, &kwargs);
+    return 0;
+}
+
 static inline PyObject* PySequence_Fast(PyObject* seq, const char* msg) {
     if (mp_obj_is_type(seq, &mp_type_list) || mp_obj_is_type(seq, &mp_type_tuple)) {
         return seq;
     }
-    mp_raise_TypeError(MP_ERROR_TEXT(msg));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT(msg));
     return NULL;
 }
 
@@ -833,17 +2888,17 @@ static inline Py_ssize_t PyDict_Size(PyObject* dict) {
     if (mp_obj_is_type(dict, &mp_type_dict)) {
         return mp_obj_dict_get_len(dict);
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected dict"));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected dict"));
     return -1;
 }
 
 static inline PyObject* PyDict_GetItem(PyObject* dict, PyObject* key) {
     if (mp_obj_is_type(dict, &mp_type_dict)) {
         mp_map_t* map = mp_obj_dict_get_map(dict);
-        mp_map_elem_t* elem = mp_map_lookup(map, key, MP_MAP_LOOKUP);
+        mp_map_elem_t* elem = __Pyx_mp_map_lookup_fast(map, key);
         return elem ? elem->value : NULL;
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected dict"));
+    // No exception for a non-dict, as in CPython.
     return NULL;
 }
 
@@ -852,7 +2907,7 @@ static inline int PyDict_DelItem(PyObject* dict, PyObject* key) {
         mp_obj_dict_delete(dict, key);
         return 0;
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected dict"));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected dict"));
     return -1;
 }
 
@@ -860,7 +2915,7 @@ static inline PyObject* PyDict_Keys(PyObject* dict) {
     if (mp_obj_is_type(dict, &mp_type_dict)) {
         return mp_obj_dict_keys(dict);
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected dict"));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected dict"));
     return NULL;
 }
 
@@ -868,7 +2923,7 @@ static inline PyObject* PyDict_Values(PyObject* dict) {
     if (mp_obj_is_type(dict, &mp_type_dict)) {
         return mp_obj_dict_values(dict);
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected dict"));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected dict"));
     return NULL;
 }
 
@@ -876,10 +2931,373 @@ static inline PyObject* PyDict_Items(PyObject* dict) {
     if (mp_obj_is_type(dict, &mp_type_dict)) {
         return mp_obj_dict_items(dict);
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("expected dict"));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected dict"));
     return NULL;
 }
 
+// ---------------------
+// Dictionary Iteration
+// ---------------------
+// Cython's "for k, v in d.items()" protocol. For real dicts the iterator is
+// the dict itself and __Pyx_dict_iter_next walks its mp_map_t table in place,
+// skipping empty/deleted slots and handing back key and value without
+// building a tuple per entry. Other mappings fall back to calling the method.
+static inline PyObject* __Pyx_dict_iterator(PyObject* dict, int is_dict, PyObject* method_name,
+                                            Py_ssize_t* p_orig_length, int* p_is_dict) {
+    if (is_dict || mp_obj_is_dict_or_ordereddict(dict)) {
+        *p_is_dict = 1;
+        *p_orig_length = (Py_ssize_t)mp_obj_dict_get_map(dict)->used;
+        return dict;
+    }
+    *p_is_dict = 0;
+    *p_orig_length = 0;
+    if (method_name != NULL) {
+        dict = mp_call_function_0(mp_load_attr(dict, mp_obj_str_get_qstr(method_name)));
+    }
+    return mp_getiter(dict, NULL);
+}
+
+static inline int __Pyx_dict_iter_next(PyObject* iter_obj, Py_ssize_t orig_length, Py_ssize_t* ppos,
+                                       PyObject** pkey, PyObject** pvalue, PyObject** pitem, int is_dict) {
+    if (is_dict) {
+        mp_map_t* map = mp_obj_dict_get_map(iter_obj);
+        if ((Py_ssize_t)map->used != orig_length) {
+            __Pyx_mp_err_set_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("dictionary changed size during iteration"));
+            return -1;
+        }
+        for (size_t pos = (size_t)*ppos; pos < map->alloc; pos++) {
+            if (!mp_map_slot_is_filled(map, pos)) {
+                continue;
+            }
+            mp_map_elem_t* elem = &map->table[pos];
+            *ppos = (Py_ssize_t)(pos + 1);
+            if (pitem != NULL) {
+                mp_obj_t kv[2] = { elem->key, elem->value };
+                *pitem = mp_obj_new_tuple(2, kv);
+            } else {
+                if (pkey != NULL) {
+                    *pkey = elem->key;
+                }
+                if (pvalue != NULL) {
+                    *pvalue = elem->value;
+                }
+            }
+            return 1;
+        }
+        *ppos = (Py_ssize_t)map->alloc;
+        return 0;
+    }
+    mp_obj_t next = mp_iternext(iter_obj);
+    if (next == MP_OBJ_STOP_ITERATION) {
+        return 0;
+    }
+    if (pitem != NULL) {
+        *pitem = next;
+    } else if (pkey != NULL && pvalue != NULL) {
+        mp_obj_t* kv;
+        mp_obj_get_array_fixed_n(next, 2, &kv);
+        *pkey = kv[0];
+        *pvalue = kv[1];
+    } else if (pkey != NULL) {
+        *pkey = next;
+    } else if (pvalue != NULL) {
+        *pvalue = next;
+    }
+    return 1;
+}
+
+// ============================================================
+// Bulk Numeric Conversion
+// ============================================================
+// Convert a whole list/tuple of numbers to a C array in one call, reading the
+// item array directly. Under MICROPY_OBJ_REPR_A on x86-64 a small int is
+// (value << 1) | 1 in a 64-bit word, so runs of small ints are checked and
+// decoded with SSE2 (baseline) or AVX2 (picked at runtime). Anything else
+// drops to the scalar loop, which handles big ints, bool and errors.
+#if MICROPY_OBJ_REPR == MICROPY_OBJ_REPR_A && defined(__x86_64__) && defined(__GNUC__)
+#define __PYX_MP_SIMD_UNBOX 1
+#include <immintrin.h>
+#else
+#define __PYX_MP_SIMD_UNBOX 0
+#endif
+
+#if __PYX_MP_SIMD_UNBOX
+static inline int __Pyx_mp_have_avx2(void) {
+    static int cached = -1;
+    if (cached < 0) {
+        __builtin_cpu_init();
+        cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return cached;
+}
+
+// Each kernel returns how many leading items it converted; it stops at the
+// first vector containing a non-small-int (or, for int32, an out-of-range value).
+static inline size_t __Pyx_mp_unbox_i64_sse2(const mp_obj_t* items, size_t n, int64_t* out) {
+    const __m128i one = _mm_set1_epi64x(1);
+    const __m128i msb = _mm_set1_epi64x(INT64_MIN);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(items + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(v, one), one)) != 0xFFFF) {
+            break;
+        }
+        // Arithmetic shift right by one: logical shift, then restore the sign bit.
+        __m128i dec = _mm_or_si128(_mm_srli_epi64(v, 1), _mm_and_si128(v, msb));
+        _mm_storeu_si128((__m128i*)(out + i), dec);
+    }
+    return i;
+}
+
+static inline size_t __Pyx_mp_unbox_i32_sse2(const mp_obj_t* items, size_t n, int32_t* out) {
+    const __m128i one = _mm_set1_epi64x(1);
+    const __m128i msb = _mm_set1_epi64x(INT64_MIN);
+    const __m128i bias = _mm_set1_epi64x((int64_t)1 << 31);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(items + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(v, one), one)) != 0xFFFF) {
+            break;
+        }
+        __m128i dec = _mm_or_si128(_mm_srli_epi64(v, 1), _mm_and_si128(v, msb));
+        // In int32 range iff (dec + 2^31) has no bits above bit 31.
+        __m128i hi = _mm_srli_epi64(_mm_add_epi64(dec, bias), 32);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(hi, zero)) != 0xFFFF) {
+            break;
+        }
+        _mm_storel_epi64((__m128i*)(out + i), _mm_shuffle_epi32(dec, _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t __Pyx_mp_unbox_i64_avx2(const mp_obj_t* items, size_t n, int64_t* out) {
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i msb = _mm256_set1_epi64x(INT64_MIN);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(items + i));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(_mm256_and_si256(v, one), one)) != -1) {
+            break;
+        }
+        __m256i dec = _mm256_or_si256(_mm256_srli_epi64(v, 1), _mm256_and_si256(v, msb));
+        _mm256_storeu_si256((__m256i*)(out + i), dec);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t __Pyx_mp_unbox_i32_avx2(const mp_obj_t* items, size_t n, int32_t* out) {
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i msb = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i bias = _mm256_set1_epi64x((int64_t)1 << 31);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i low_dwords = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(items + i));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(_mm256_and_si256(v, one), one)) != -1) {
+            break;
+        }
+        __m256i dec = _mm256_or_si256(_mm256_srli_epi64(v, 1), _mm256_and_si256(v, msb));
+        __m256i hi = _mm256_srli_epi64(_mm256_add_epi64(dec, bias), 32);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(hi, zero)) != -1) {
+            break;
+        }
+        __m256i packed = _mm256_permutevar8x32_epi32(dec, low_dwords);
+        _mm_storeu_si128((__m128i*)(out + i), _mm256_castsi256_si128(packed));
+    }
+    return i;
+}
+#endif
+
+// Fetch the item array of a list or tuple and check it fits in the output.
+// Like the converters below, returns -1 with the exception pending on error.
+static inline Py_ssize_t __Pyx_mp_bulk_items(PyObject* seq, Py_ssize_t maxlen, mp_obj_t** items) {
+    if (!mp_obj_is_type(seq, &mp_type_list) && !mp_obj_is_type(seq, &mp_type_tuple)) {
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected list or tuple"));
+        return -1;
+    }
+    size_t n;
+    mp_obj_get_array(seq, &n, items);
+    if (n > (size_t)maxlen) {
+        __Pyx_mp_err_set_msg(&mp_type_ValueError, MP_ERROR_TEXT("output buffer too small"));
+        return -1;
+    }
+    return (Py_ssize_t)n;
+}
+
+// __Pyx_PySequence_AsInt64Array: Returns the number of items written.
+static inline Py_ssize_t __Pyx_PySequence_AsInt64Array(PyObject* seq, int64_t* out, Py_ssize_t maxlen) {
+    mp_obj_t* items;
+    Py_ssize_t len = __Pyx_mp_bulk_items(seq, maxlen, &items);
+    if (len < 0) {
+        return -1;
+    }
+    size_t n = (size_t)len;
+    size_t i = 0;
+    #if __PYX_MP_SIMD_UNBOX
+    i = __Pyx_mp_have_avx2() ? __Pyx_mp_unbox_i64_avx2(items, n, out) : __Pyx_mp_unbox_i64_sse2(items, n, out);
+    #endif
+    for (; i < n; i++) {
+        mp_obj_t item = items[i];
+        long long v = mp_obj_is_small_int(item) ? MP_OBJ_SMALL_INT_VALUE(item) : __Pyx_mp_int_as_ll(item);
+        if (v == -1 && __Pyx_mp_err_get() != MP_OBJ_NULL) {
+            return -1;
+        }
+        out[i] = v;
+    }
+    return (Py_ssize_t)n;
+}
+
+static inline Py_ssize_t __Pyx_PySequence_AsInt32Array(PyObject* seq, int32_t* out, Py_ssize_t maxlen) {
+    mp_obj_t* items;
+    Py_ssize_t len = __Pyx_mp_bulk_items(seq, maxlen, &items);
+    if (len < 0) {
+        return -1;
+    }
+    size_t n = (size_t)len;
+    size_t i = 0;
+    #if __PYX_MP_SIMD_UNBOX
+    i = __Pyx_mp_have_avx2() ? __Pyx_mp_unbox_i32_avx2(items, n, out) : __Pyx_mp_unbox_i32_sse2(items, n, out);
+    #endif
+    for (; i < n; i++) {
+        mp_obj_t item = items[i];
+        long long v = mp_obj_is_small_int(item) ? MP_OBJ_SMALL_INT_VALUE(item) : __Pyx_mp_int_as_ll(item);
+        if (v == -1 && __Pyx_mp_err_get() != MP_OBJ_NULL) {
+            return -1;
+        }
+        if (v < INT32_MIN || v > INT32_MAX) {
+            return __Pyx_mp_err_int_overflow();
+        }
+        out[i] = (int32_t)v;
+    }
+    return (Py_ssize_t)n;
+}
+
+// Doubles: small ints have no cheap vector int64 -> double conversion before
+// AVX-512, so this is a tight scalar loop with inline decoding of both kinds.
+// Anything else goes through PyFloat_AsDouble, whose __float__ call can run
+// code that resizes the list, so the item array is fetched again after it.
+static inline Py_ssize_t __Pyx_PySequence_AsDoubleArray(PyObject* seq, double* out, Py_ssize_t maxlen) {
+    mp_obj_t* items;
+    Py_ssize_t n = __Pyx_mp_bulk_items(seq, maxlen, &items);
+    for (Py_ssize_t i = 0; i < n; i++) {
+        mp_obj_t item = items[i];
+        if (mp_obj_is_small_int(item)) {
+            out[i] = (double)MP_OBJ_SMALL_INT_VALUE(item);
+        } else if (mp_obj_is_float(item)) {
+            out[i] = mp_obj_float_get(item);
+        } else {
+            out[i] = PyFloat_AsDouble(item);
+            if (out[i] == -1.0 && __Pyx_mp_err_get() != MP_OBJ_NULL) {
+                return -1;
+            }
+            n = __Pyx_mp_bulk_items(seq, maxlen, &items);
+        }
+    }
+    return n;
+}
+
+// ---------------------
+// Bulk Boxing (C arrays to lists)
+// ---------------------
+// The list is allocated once at its final size and filled in place. Values in
+// the small-int range are encoded inline with no allocation (vectorised with
+// SSE2 under MICROPY_OBJ_REPR_A on x86-64); only the rest are boxed.
+#if __PYX_MP_SIMD_UNBOX
+// Encode leading int64 values; stops at the first pair that needs a big int.
+static inline size_t __Pyx_mp_box_i64_sse2(const int64_t* data, size_t n, mp_obj_t* items) {
+    const __m128i one = _mm_set1_epi64x(1);
+    const __m128i msb = _mm_set1_epi64x(INT64_MIN);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i shl = _mm_slli_epi64(v, 1);
+        // Fits iff the top two bits agree, i.e. the shift did not change the sign.
+        __m128i lost = _mm_and_si128(_mm_xor_si128(v, shl), msb);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(lost, zero)) != 0xFFFF) {
+            break;
+        }
+        _mm_storeu_si128((__m128i*)(items + i), _mm_or_si128(shl, one));
+    }
+    return i;
+}
+
+// Every int32 fits in a 64-bit small int, so this never stops early.
+static inline size_t __Pyx_mp_box_i32_sse2(const int32_t* data, size_t n, mp_obj_t* items) {
+    const __m128i one = _mm_set1_epi64x(1);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i sign = _mm_srai_epi32(v, 31);
+        __m128i lo = _mm_unpacklo_epi32(v, sign);
+        __m128i hi = _mm_unpackhi_epi32(v, sign);
+        _mm_storeu_si128((__m128i*)(items + i), _mm_or_si128(_mm_slli_epi64(lo, 1), one));
+        _mm_storeu_si128((__m128i*)(items + i + 2), _mm_or_si128(_mm_slli_epi64(hi, 1), one));
+    }
+    return i;
+}
+#endif
+
+// Returns NULL with the exception pending for a negative size.
+static inline mp_obj_t* __Pyx_mp_bulk_new_list(Py_ssize_t n, PyObject** list) {
+    if (n < 0) {
+        __Pyx_mp_err_set_msg(&mp_type_ValueError, MP_ERROR_TEXT("negative size"));
+        return NULL;
+    }
+    *list = mp_obj_new_list((size_t)n, NULL);
+    return ((mp_obj_list_t*)MP_OBJ_TO_PTR(*list))->items;
+}
+
+static inline PyObject* __Pyx_PyList_FromInt64Array(const int64_t* data, Py_ssize_t n) {
+    PyObject* list;
+    mp_obj_t* items = __Pyx_mp_bulk_new_list(n, &list);
+    if (items == NULL) {
+        return NULL;
+    }
+    size_t i = 0;
+    #if __PYX_MP_SIMD_UNBOX
+    i = __Pyx_mp_box_i64_sse2(data, (size_t)n, items);
+    #endif
+    for (; i < (size_t)n; i++) {
+        items[i] = __Pyx_mp_int_from_ll(data[i]);
+    }
+    return list;
+}
+
+static inline PyObject* __Pyx_PyList_FromInt32Array(const int32_t* data, Py_ssize_t n) {
+    PyObject* list;
+    mp_obj_t* items = __Pyx_mp_bulk_new_list(n, &list);
+    if (items == NULL) {
+        return NULL;
+    }
+    size_t i = 0;
+    #if __PYX_MP_SIMD_UNBOX
+    i = __Pyx_mp_box_i32_sse2(data, (size_t)n, items);
+    #endif
+    for (; i < (size_t)n; i++) {
+        items[i] = __Pyx_mp_int_from_ll(data[i]);
+    }
+    return list;
+}
+
+// Floats are free to box under MICROPY_OBJ_REPR_C/_D; elsewhere each one is a
+// separate allocation (see PyFloat_FromDouble).
+static inline PyObject* __Pyx_PyList_FromDoubleArray(const double* data, Py_ssize_t n) {
+    PyObject* list;
+    mp_obj_t* items = __Pyx_mp_bulk_new_list(n, &list);
+    if (items == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < (size_t)n; i++) {
+        items[i] = mp_obj_new_float((mp_float_t)data[i]);
+    }
+    return list;
+}
+
 // ============================================================
 // Miscellaneous Functions
 // ============================================================
@@ -898,7 +3316,7 @@ static inline PyObject* Py_BuildValue(const char* format, ...) {
     } else if (strcmp(format, "O") == 0) {
         result = va_arg(args, PyObject*);
     } else {
-        mp_raise_ValueError(MP_ERROR_TEXT("unsupported format in Py_BuildValue"));
+        __Pyx_mp_err_set_msg(&mp_type_ValueError, MP_ERROR_TEXT("unsupported format in Py_BuildValue"));
     }
     va_end(args);
     return result;
@@ -921,11 +3339,13 @@ static inline PyObject* PyObject_CallObject(PyObject* callable, PyObject* args)
 // PyObject_CallMethod: Minimal support for calling a no-argument method.
 static inline PyObject* PyObject_CallMethod(PyObject* obj, const char* method, const char* format, ...) {
     if (format && format[0] != '\0') {
-        mp_raise_NotImplementedError(MP_ERROR_TEXT("PyObject_CallMethod with arguments not implemented"));
+        __Pyx_mp_err_set_msg(&mp_type_NotImplementedError, MP_ERROR_TEXT("PyObject_CallMethod with arguments not implemented"));
+        return NULL;
     }
     PyObject* attr = mp_load_attr(obj, mp_obj_new_str(method, strlen(method)));
     if (attr == MP_OBJ_NULL) {
-        mp_raise_AttributeError(MP_ERROR_TEXT("object has no attribute"));
+        __Pyx_mp_err_set_msg(&mp_type_AttributeError, MP_ERROR_TEXT("object has no attribute"));
+        return NULL;
     }
     return mp_call_function_0(attr);
 }
@@ -933,7 +3353,8 @@ static inline PyObject* PyObject_CallMethod(PyObject* obj, const char* method, c
 // PyObject_CallFunction: Minimal support (only no-argument calls).
 static inline PyObject* PyObject_CallFunction(PyObject* callable, const char* format, ...) {
     if (format && format[0] != '\0') {
-        mp_raise_NotImplementedError(MP_ERROR_TEXT("PyObject_CallFunction with arguments not implemented"));
+        __Pyx_mp_err_set_msg(&mp_type_NotImplementedError, MP_ERROR_TEXT("PyObject_CallFunction with arguments not implemented"));
+        return NULL;
     }
     return mp_call_function_0(callable);
 }
@@ -948,21 +3369,16 @@ static inline PyObject* PyNumber_Index(PyObject* obj) {
     if (mp_obj_is_int(obj)) {
         return obj;
     }
-    mp_raise_TypeError(MP_ERROR_TEXT("an integer is required"));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("an integer is required"));
     return NULL;
 }
 
-// PyFloat_FromDouble: Create a new float object from a C double.
-static inline PyObject* PyFloat_FromDouble(double val) {
-    return mp_obj_new_float(val);
-}
-
 // PySequence_Contains: Checks if 'ob' is in the sequence 'seq'.
 static inline int PySequence_Contains(PyObject* seq, PyObject* ob) {
     PyObject* iter = mp_getiter(seq, NULL);
     if (iter == MP_OBJ_NULL) {
-        mp_raise_TypeError(MP_ERROR_TEXT("object is not iterable"));
-        return 0;
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("object is not iterable"));
+        return -1;
     }
     PyObject* item;
     while ((item = mp_iternext(iter)) != MP_OBJ_STOP_ITERATION) {
@@ -999,7 +3415,7 @@ static inline PyObject* PyObject_Dir(PyObject* obj) {
     if (mp_obj_is_type(obj, &mp_type_module)) {
         return mp_obj_dict_keys(mp_obj_module_get_globals(obj));
     }
-    mp_raise_NotImplementedError(MP_ERROR_TEXT("PyObject_Dir is not implemented for this type"));
+    __Pyx_mp_err_set_msg(&mp_type_NotImplementedError, MP_ERROR_TEXT("PyObject_Dir is not implemented for this type"));
     return NULL;
 }
 
@@ -1007,7 +3423,7 @@ static inline PyObject* PyObject_Dir(PyObject* obj) {
 static inline int PyArg_UnpackTuple(PyObject *args, const char *name, Py_ssize_t min, Py_ssize_t max, ...) {
     Py_ssize_t n = PySequence_Size(args);
     if (n < min || n > max) {
-        mp_raise_ValueError(MP_ERROR_TEXT("argument count mismatch"));
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("argument count mismatch"));
         return 0;
     }
     va_list vargs;
@@ -1033,6 +3449,7 @@ static inline PyObject* PyUnicode_FromFormat(const char* format, ...) {
 // PyType_IsSubtype: Minimal stub (only supports equality).
 static inline int PyType_IsSubtype(PyObject* a, PyObject* b) {
     if (a == b) return 1;
+    // CPython's version cannot fail, so there is no sentinel to return.
     mp_raise_NotImplementedError(MP_ERROR_TEXT("PyType_IsSubtype not fully implemented"));
     return 0;
 }
@@ -1053,28 +3470,19 @@ static inline int PyObject_IsSubclass(PyObject* derived, PyObject* base) {
     return derived == base;
 }
 
-// PyErr_BadArgument: Convenience function to raise a bad argument error.
+// PyErr_BadArgument: Sets a TypeError, like CPython, and returns 0.
 static inline int PyErr_BadArgument(void) {
-    mp_raise_ValueError(MP_ERROR_TEXT("bad argument"));
+    __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("bad argument"));
     return 0;
 }
 
 // PyTuple_GetSlice: Return a new tuple which is a slice of an existing tuple.
 static inline PyObject* PyTuple_GetSlice(PyObject* tuple, Py_ssize_t low, Py_ssize_t high) {
     if (!mp_obj_is_type(tuple, &mp_type_tuple)) {
-        mp_raise_TypeError(MP_ERROR_TEXT("expected tuple"));
+        __Pyx_mp_err_set_msg(&mp_type_TypeError, MP_ERROR_TEXT("expected tuple"));
         return NULL;
     }
-    Py_ssize_t size = PyTuple_Size(tuple);
-    if (low < 0) low = 0;
-    if (high > size) high = size;
-    Py_ssize_t new_size = high - low;
-    PyObject* new_tuple = PyTuple_New(new_size);
-    for (Py_ssize_t i = 0; i < new_size; i++) {
-        PyObject* item = PyTuple_GetItem(tuple, low + i);
-        PyTuple_SET_ITEM(new_tuple, i, item);
-    }
-    return new_tuple;
+    return __Pyx_mp_slice_fast(tuple, low, high, 0);
 }
 
 // PyBool_FromLong: Return Py_True or Py_False based on the value.
@@ -1084,7 +3492,7 @@ static inline PyObject* PyBool_FromLong(long v) {
 
 // PyErr_NoMemory: Raise a MemoryError.
 static inline PyObject* PyErr_NoMemory(void) {
-    mp_raise_MemoryError();
+    __Pyx_mp_err_set_msg(&mp_type_MemoryError, NULL);
     return NULL;
 }
 
@@ -1170,6 +3578,9 @@ static inline void PyMem_RawFree(void* ptr) {
 
 // PyMem_Calloc: Allocate and zero-initialize memory.
 static inline void* PyMem_Calloc(size_t nelem, size_t elsize) {
+    if (elsize != 0 && nelem > (size_t)-1 / elsize) {
+        return NULL;
+    }
     size_t total = nelem * elsize;
     void* ptr = m_malloc(total);
     if (ptr) {
@@ -1195,7 +3606,8 @@ static inline void PyGILState_Release(PyGILState_STATE state) {
 // PyCFunction_NewEx: Create a built-in function object from a PyMethodDef.
 static inline PyObject* PyCFunction_NewEx(PyMethodDef *def, PyObject *self, PyObject *module) {
     if (def == NULL || def->ml_meth == NULL) {
-        mp_raise_ValueError(MP_ERROR_TEXT("invalid PyMethodDef"));
+        __Pyx_mp_err_set_msg(&mp_type_ValueError, MP_ERROR_TEXT("invalid PyMethodDef"));
+        return NULL;
     }
     // This simplistic implementation ignores 'self' and 'module' and flags.
     return mp_obj_new_fun_builtin(def->ml_meth, 0);
@@ -1208,6 +3620,23 @@ static inline PyObject* PyCFunction_NewEx(PyMethodDef *def, PyObject *self, PyOb
 #define __pyx_mstate_global ((void*)0)
 #define __pyx_d NULL
 
+// ROM-resident module constants: modify_includes.py --rom-constants replaces the
+// init-time PyTuple_Pack/string table objects with these statically initialised
+// objects, so they cost no heap and nothing at import. Hash 0 is computed lazily.
+#define __PYX_MP_ROM_STR(obj_name, lit) static const MP_DEFINE_STR_OBJ(obj_name, lit)
+#define __PYX_MP_ROM_BYTES(obj_name, lit) \
+    static const mp_obj_str_t obj_name = {{&mp_type_bytes}, 0, sizeof(lit) - 1, (const byte *)(lit)}
+#define __PYX_MP_ROM_TUPLE(obj_name, n, ...) \
+    static const mp_rom_obj_tuple_t obj_name = {{&mp_type_tuple}, n, {__VA_ARGS__}}
+
+// Reset the header's static state, which survives a soft reset while the heap it
+// points into does not. modify_includes.py calls this at the start of every
+// Cython module's exec, which runs before any other Cython code after a reset;
+// PyModule_Create then attaches a fresh module state.
+static inline void __Pyx_mp_state_init(void) {
+    __pyx_mp_state = NULL;
+}
+
 #define CYTHON_USE_TYPE_SLOTS 0
 #define CYTHON_FAST_THREAD_STATE 0
 #define CYTHON_FAST_PYCALL 0
@@ -1,14 +1,468 @@
-import sys
+import argparse
 import re
+import html.entities
 
-def modify_c_file(file_path):
+# Mirrors qstr_escape() in MicroPython's py/makeqstrdata.py so the MP_QSTR_* names
+# emitted here match the identifiers the qstr generator derives from our Q() lines
+codepoint2name = dict(html.entities.codepoint2name)
+codepoint2name.update({
+    ord("-"): "hyphen", ord(" "): "space", ord("'"): "squot", ord(","): "comma",
+    ord("."): "dot", ord(":"): "colon", ord(";"): "semicolon", ord("/"): "slash",
+    ord("%"): "percent", ord("#"): "hash", ord("("): "paren_open", ord(")"): "paren_close",
+    ord("["): "bracket_open", ord("]"): "bracket_close", ord("{"): "brace_open",
+    ord("}"): "brace_close", ord("*"): "star", ord("!"): "bang", ord("\\"): "backslash",
+    ord("+"): "plus", ord("$"): "dollar", ord("="): "equals", ord("?"): "question",
+    ord("@"): "at_sign", ord("^"): "caret", ord("|"): "pipe", ord("~"): "tilde",
+})
+
+def qstr_escape(qst):
+    def esc_char(m):
+        c = ord(m.group(0))
+        return "_" + codepoint2name[c] + "_" if c in codepoint2name else "0x%02x" % c
+    return re.sub(r"[^A-Za-z0-9_]", esc_char, qst)
+
+def qstr_compatible(value):
+    # Only plain printable ASCII without C escapes; qstr lengths are limited to a byte
+    return 0 < len(value) < 256 and '\\' not in value and all(' ' <= c <= '~' for c in value)
+
+def set_constant(content, name, expr, prefix=''):
+    # Point an object accessor at a constant expression and retire its runtime slot.
+    # Cython 3 keeps the object in the module state struct behind a #define accessor,
+    # Cython 0.29 in a file-level static; prefix is emitted just before the accessor.
+    n = re.escape(name)
+    define = prefix + '#define %s %s' % (name, expr)
+    content = re.sub(r'^[ \t]*\{&' + n + r', .*\},\n', '', content, flags=re.MULTILINE)
+    content = re.sub(r'^[ \t]*Py_(CLEAR|VISIT)\(\w+->' + n + r'\);\n', '', content, flags=re.MULTILINE)
+    if re.search(r'^#define ' + n + ' ', content, flags=re.MULTILINE):
+        content = re.sub(r'^[ \t]*PyObject \*' + n + r';\n', '', content, flags=re.MULTILINE)
+        return re.sub(r'^#define ' + n + r' .*$', lambda m: define, content, count=1, flags=re.MULTILINE)
+    return re.sub(r'^static PyObject \*' + n + r';$', lambda m: define, content, count=1, flags=re.MULTILINE)
+
+def drop_unused_literal(content, k_name):
+    # Drop the C literal once nothing but its declaration refers to it
+    if len(re.findall(r'\b' + re.escape(k_name) + r'\b', content)) == 1:
+        content = re.sub(r'^static const char ' + re.escape(k_name) + r'\[\] = .*\n', '', content, flags=re.MULTILINE)
+    return content
+
+def precompute_qstrs(content, qstrs):
+    # Cython emits one "static const char __pyx_k_X[] = ..." per string constant and a
+    # string table row per object that __Pyx_InitStrings() interns at import time.
+    # Identifier rows (__pyx_n_s_*) become MP_QSTR_* constants resolved at build time.
+    literals = dict(re.findall(r'^static const char (__pyx_k_\w+)\[\] = "(.*)";$', content, flags=re.MULTILINE))
+    row = re.compile(r'^[ \t]*\{&(__pyx_n_s_\w+), (__pyx_k_\w+), sizeof\(\2\), 0, 0, 1, 1\},\n', flags=re.MULTILINE)
+    for name, k_name in row.findall(content):
+        value = literals.get(k_name)
+        if value is None or not qstr_compatible(value):
+            continue
+        content = set_constant(content, name, 'MP_OBJ_NEW_QSTR(MP_QSTR_%s)' % qstr_escape(value))
+        content = drop_unused_literal(content, k_name)
+        qstrs.add(value)
+    return content
+
+def small_int_constants(content):
+    # Cython creates every integer literal (__pyx_int_N) with PyInt_FromLong() at import;
+    # anything inside the small int range of every object representation (30 bits under
+    # MICROPY_OBJ_REPR_B) is a compile-time MP_OBJ_NEW_SMALL_INT instead
+    init = re.compile(r'^[ \t]*(__pyx_int_\w+) = PyInt_FromLong\((-?\d+)L?\); if \(unlikely\(!\1\)\) __PYX_ERR\([^)]*\)\n', flags=re.MULTILINE)
+    for m in list(init.finditer(content)):
+        name, value = m.group(1), int(m.group(2))
+        if -(1 << 29) <= value < (1 << 29):
+            content = content.replace(m.group(0), '', 1)
+            content = set_constant(content, name, 'MP_OBJ_NEW_SMALL_INT(%d)' % value)
+    return content
+
+def rom_item(content, name):
+    # ROM initialiser for an accessor already rewritten to a constant, else None
+    fixed = {'Py_None': 'MP_ROM_NONE', 'Py_True': 'MP_ROM_TRUE', 'Py_False': 'MP_ROM_FALSE'}
+    if name in fixed:
+        return fixed[name]
+    m = re.search(r'^#define ' + re.escape(name) + r' (.*)$', content, flags=re.MULTILINE)
+    if m is None:
+        return None
+    for pattern, rom in ((r'MP_OBJ_NEW_QSTR\((MP_QSTR_\w+)\)', r'MP_ROM_QSTR(\1)'),
+                         (r'MP_OBJ_NEW_SMALL_INT\((-?\d+)\)', r'MP_ROM_INT(\1)'),
+                         (r'MP_OBJ_FROM_PTR\((&\w+)\)', r'MP_ROM_PTR(\1)')):
+        if re.fullmatch(pattern, m.group(1)):
+            return re.sub(pattern, rom, m.group(1))
+    return None
+
+ROM_TUPLES_MARKER = '/* __PYX_MP_ROM_TUPLES */\n'
+
+def rom_constants(content):
+    # The empty singletons already exist in MicroPython's ROM
+    empties = {
+        '__pyx_empty_tuple': 'MP_OBJ_FROM_PTR(&mp_const_empty_tuple_obj)',
+        '__pyx_empty_bytes': 'MP_OBJ_FROM_PTR(&mp_const_empty_bytes_obj)',
+        '__pyx_empty_unicode': 'MP_OBJ_NEW_QSTR(MP_QSTR_)',
+    }
+    for name, expr in empties.items():
+        if re.search(r'^[ \t]*' + name + r' = ', content, flags=re.MULTILINE):
+            content = re.sub(r'^[ \t]*' + name + r' = .*\n', '', content, flags=re.MULTILINE)
+            content = set_constant(content, name, expr)
+
+    # Non-interned str/bytes constants (__pyx_kp_*) become static str objects sharing the
+    # C literal; string table row fields are (encoding, is_unicode, is_str, intern)
+    row = re.compile(r'^[ \t]*\{&(__pyx_kp_[sub]_\w+), (__pyx_k_\w+), sizeof\(\2\), 0, (0|1), (0|1), 0\},\n', flags=re.MULTILINE)
+    for name, k_name, is_unicode, is_str in row.findall(content):
+        macro = '__PYX_MP_ROM_BYTES' if is_unicode == '0' and is_str == '0' else '__PYX_MP_ROM_STR'
+        content = re.sub(r'^(static const char ' + re.escape(k_name) + r'\[\] = .*)$',
+                         lambda m: '%s\n%s(%s_rom, %s);' % (m.group(1), macro, name, k_name),
+                         content, count=1, flags=re.MULTILINE)
+        content = set_constant(content, name, 'MP_OBJ_FROM_PTR(&%s_rom)' % name)
+
+    # Constant tuples whose items all have ROM forms; Cython packs inner tuples first,
+    # so nested tuples resolve in order and the definitions are emitted as one block
+    pack = re.compile(r'^[ \t]*(\w+) = PyTuple_Pack\((\d+), (.*)\); if \(unlikely\(!\1\)\) __PYX_ERR\([^)]*\)\n'
+                      r'(?:[ \t]*__Pyx_GOTREF\(\1\);\n)?(?:[ \t]*__Pyx_GIVEREF\(\1\);\n)?', flags=re.MULTILINE)
+    tuples = []
+    for m in list(pack.finditer(content)):
+        name, count, args = m.group(1), m.group(2), m.group(3).split(', ')
+        items = [rom_item(content, a) for a in args]
+        if len(items) != int(count) or None in items:
+            continue
+        content = content.replace(m.group(0), '', 1)
+        content = set_constant(content, name, 'MP_OBJ_FROM_PTR(&%s_rom)' % name, '' if tuples else ROM_TUPLES_MARKER)
+        tuples.append('__PYX_MP_ROM_TUPLE(%s_rom, %s, %s);\n' % (name, count, ', '.join(items)))
+    return content.replace(ROM_TUPLES_MARKER, ''.join(tuples), 1)
+
+def apply_edits(content, edits):
+    # Apply (start, end, text) replacements, all given as offsets into content; an
+    # insertion has start == end and insertions at one offset keep their order
+    out, pos = [], 0
+    for start, end, text in sorted(edits, key=lambda e: (e[0], e[1])):
+        out.append(content[pos:start])
+        out.append(text)
+        pos = end
+    out.append(content[pos:])
+    return ''.join(out)
+
+def list_templates(content):
+    # A list display of constants ("[1, 2, 3]") is built by Cython as PyList_New(n) plus n
+    # checked SET_ITEM calls on every evaluation. When every item has a ROM form the
+    # items go into a ROM tuple template defined before the enclosing function, and
+    # the list is created from it with __Pyx_PyList_FromTemplate (one memcpy).
+    item = r'\1__Pyx_INCREF\(\w+\);\n\1__Pyx_GIVEREF\(\w+\);\n\1(?:if \()?__Pyx_PyList_SET_ITEM\(\2, \d+, \w+\)\)?(?: __PYX_ERR\([^)]*\))?;\n'
+    literal = re.compile(r'^([ \t]*)(\w+) = PyList_New\((\d+)\); (if \(unlikely\(!\2\)\) __PYX_ERR\([^)]*\))\n'
+                         r'\1__Pyx_GOTREF\(\2\);\n((?:' + item + r')+)', flags=re.MULTILINE)
+    func = re.compile(r'^[A-Za-z_][^;\n]*\)[ \t]*\{[ \t]*$', flags=re.MULTILINE)
+    index = len(re.findall(r'^__PYX_MP_ROM_TUPLE\(__pyx_list_template_', content, flags=re.MULTILINE))
+    edits = []
+    for m in literal.finditer(content):
+        indent, target, count, check = m.group(1), m.group(2), int(m.group(3)), m.group(4)
+        sets = re.findall(r'__Pyx_PyList_SET_ITEM\(\w+, (\d+), (\w+)\)', m.group(5))
+        items = [rom_item(content, value) for _, value in sets]
+        if [int(i) for i, _ in sets] != list(range(count)) or None in items:
+            continue
+        starts = [f.start() for f in func.finditer(content, 0, m.start())]
+        if not starts:
+            continue
+        name = '__pyx_list_template_%d' % index
+        index += 1
+        edits.append((starts[-1], starts[-1], '__PYX_MP_ROM_TUPLE(%s, %d, %s);\n' % (name, count, ', '.join(items))))
+        edits.append((m.start(), m.end(), '%s%s = __Pyx_PyList_FromTemplate(MP_OBJ_FROM_PTR(&%s)); %s\n%s__Pyx_GOTREF(%s);\n'
+                      % (indent, target, name, check, indent, target)))
+    return apply_edits(content, edits)
+
+def make_lazy(content, name):
+    # Route an object accessor through its lazy builder; returns the storage expression
+    # the builder fills in, or None if the object has no recognisable slot
+    n = re.escape(name)
+    builder = '__pyx_lazy_init_' + name
+    m = re.search(r'^#define ' + n + r' (.*)$', content, flags=re.MULTILINE)
+    if m:
+        slot, ctype, decl = m.group(1), 'PyObject', ''
+    else:
+        m = re.search(r'^static (\w+) \*' + n + r';$', content, flags=re.MULTILINE)
+        if m is None:
+            return content, None
+        slot, ctype = name + '__slot', m.group(1)
+        decl = 'static %s *%s;\n' % (ctype, slot)
+    # The accessor macro names itself; C does not re-expand that, so it hits the slot
+    lazy = '%sstatic %s *%s(void);\n#define %s (%s ? %s : %s())' % (decl, ctype, builder, name, slot, slot, builder)
+    content = content[:m.start()] + lazy + content[m.end():]
+    return content, (slot, ctype, builder)
+
+SLOT_LINES = r'^(?:[ \t]*(?:static )?\w+ \*{0};|[ \t]*Py_(?:CLEAR|VISIT)\(\w+->{0}\);|#define {0} .*)\n'
+
+def is_read(content, name):
+    # Any reference besides the slot declaration, clear/traverse entries and accessor
+    rest = re.sub(SLOT_LINES.format(re.escape(name)), '', content, flags=re.MULTILINE)
+    return re.search(r'\b' + re.escape(name) + r'\b', rest) is not None
+
+def drop_slot(content, name):
+    return re.sub(SLOT_LINES.format(re.escape(name)), '', content, flags=re.MULTILINE)
+
+def function_body(content, name):
+    m = re.search(r'^static [^;\n]*\b' + name + r'\(void\) \{\n', content, flags=re.MULTILINE)
+    return (m.end(), content.index('\n}\n', m.end())) if m else None
+
+CONSTANT_STMT = (r'^([ \t]*)(\w+) = (.*); if \((?:unlikely\()?!\2\)?\) (__PYX_ERR\([^)]*\))\n'
+                 r'(?:\1__Pyx_(?:GOTREF|GIVEREF)\(\2\);\n)*')
+
+def drop_unread_constants(content):
+    # Once the code objects are gone, so is the only reader of their name tuples and
+    # file name strings; drop every string row, cached constant and ROM object that
+    # nothing reads any more, repeating as each removal can orphan another
+    row = re.compile(r'^[ \t]*\{&(\w+), __pyx_k_\w+, .*\},\n', flags=re.MULTILINE)
+    stmt = re.compile(CONSTANT_STMT, flags=re.MULTILINE)
+    rom = re.compile(r'^#define (\w+) MP_OBJ_FROM_PTR\(&\1_rom\)\n', flags=re.MULTILINE)
+    while True:
+        spans = []
+        for init, pattern, group in (('__Pyx_CreateStringTabAndInitStrings', row, 1),
+                                     ('__Pyx_InitCachedConstants', stmt, 2)):
+            body = function_body(content, init)
+            if body:
+                spans += [(m.group(group), m.start(), m.end()) for m in pattern.finditer(content, body[0], body[1])]
+        spans += [(m.group(1), m.start(), m.end()) for m in rom.finditer(content)]
+        for name, start, end in spans:
+            rest = content[:start] + content[end:]
+            if not is_read(rest, name):
+                break
+        else:
+            return content
+        literals = re.findall(r'\b__pyx_k_\w+', content[start:end])
+        content = drop_slot(rest, name)
+        rom_def = re.search(r'^__PYX_MP_ROM_\w+\(' + re.escape(name) + r'_rom, .*\n', content, flags=re.MULTILINE)
+        if rom_def:
+            literals += re.findall(r'\b__pyx_k_\w+', rom_def.group(0))
+            content = content[:rom_def.start()] + content[rom_def.end():]
+        for k_name in literals:
+            content = drop_unused_literal(content, k_name)
+
+def lazy_init(content):
+    # Import-time work that is left after the passes above (strings that are not qstrs,
+    # cached builtins, non-ROM constants and code objects) is moved into one builder
+    # per object, run the first time its accessor is read. Accessors appear where Cython
+    # never checks for NULL (PyObject_SetAttr arguments, call targets), so a builder that
+    # fails raises through nlr at that use (__Pyx_mp_raise_pending in micropython.h).
+    # The slots are plain C statics that outlive a soft reset, so module exec clears
+    # them next to __Pyx_mp_state_init() (reset_module_state) before anything reads them.
+    builders = []
+    slots = []
+
+    # Code objects only back CyFunction.__code__, which nothing on MicroPython reads
+    content = re.sub(r'(__Pyx_CyFunction_New\(.*), \(\(PyObject \*\)__pyx_codeobj__\w+\)\)', r'\1, NULL)', content)
+    content = drop_unread_constants(content)
+
+    body = function_body(content, '__Pyx_CreateStringTabAndInitStrings')
+    rows = re.findall(r'^[ \t]*\{&(\w+), (__pyx_k_\w+, sizeof\(__pyx_k_\w+\), .*)\},\n', content[body[0]:body[1]] if body else '', flags=re.MULTILINE)
+    for name, rest in rows:
+        content, lazy = make_lazy(content, name)
+        if lazy is None:
+            continue
+        slot, ctype, builder = lazy
+        slots.append(slot)
+        content = re.sub(r'^[ \t]*\{&' + re.escape(name) + r', .*\},\n', '', content, count=1, flags=re.MULTILINE)
+        builders.append('static CYTHON_SMALL_CODE %s *%s(void) {\n'
+                        '  __Pyx_StringTabEntry t[] = {{&%s, %s}, {0}};\n'
+                        '  if (__Pyx_InitStrings(t) < 0) __Pyx_mp_raise_pending();\n'
+                        '  return %s;\n}\n' % (ctype, builder, slot, rest, slot))
+
+    for init in ('__Pyx_InitCachedBuiltins', '__Pyx_InitCachedConstants'):
+        stmt = re.compile(CONSTANT_STMT, flags=re.MULTILINE)
+        while True:
+            body = function_body(content, init)
+            m = body and stmt.search(content, body[0], body[1])
+            if not m:
+                break
+            name, expr, err = m.group(2), m.group(3), m.group(4)
+            content = content[:m.start()] + content[m.end():]
+            if not is_read(content, name):
+                content = drop_slot(content, name)
+                continue  # nothing reads it (e.g. a code object); never build it
+            content, lazy = make_lazy(content, name)
+            if lazy is None:
+                content = content[:m.start()] + m.group(0) + content[m.start():]
+                break
+            slot, ctype, builder = lazy
+            slots.append(slot)
+            builders.append('static CYTHON_SMALL_CODE %s *%s(void) {\n'
+                            '  %s = %s; if (unlikely(!%s)) %s\n'
+                            '  return %s;\n'
+                            '  __pyx_L1_error:;\n'
+                            '  __Pyx_mp_raise_pending();\n'
+                            '  return NULL;\n}\n' % (ctype, builder, slot, expr, slot, err, slot))
+
+    # Builders go before the first init function, after every accessor they may use
+    m = re.search(r'^static (?:CYTHON_SMALL_CODE )?int __Pyx_(?:CreateStringTabAndInitStrings|InitCachedBuiltins|InitCachedConstants)\(void\) \{$',
+                  content, flags=re.MULTILINE)
+    if builders and m:
+        content = content[:m.start()] + ''.join(builders) + content[m.start():]
+    reset = '  __Pyx_mp_state_init();\n'
+    if slots and reset in content:
+        content = content.replace(reset, reset + ''.join('  %s = NULL;\n' % slot for slot in slots), 1)
+    return content
+
+def drop_utility(content, name, only_if=None):
+    # Remove one of Cython's "/* Name */" (and "/* Name.proto */") utility code sections;
+    # only_if, given the section text, restricts this to some instances of a repeated name
+    def drop(m):
+        return '' if only_if is None or only_if(m.group(0)) else m.group(0)
+    return re.sub(r'^/\* ' + re.escape(name) + r'(?:\.proto)? \*/\n.*?(?=^/\* [\w.]+ \*/$|^/\* #### )', drop,
+                  content, flags=re.MULTILINE | re.DOTALL)
+
+def drop_function(content, name):
+    # Remove the prototype and definition of one function from Cython's inline
+    # TypeConversion code, which is emitted without "/* Name */" section markers
+    n = re.escape(name)
+    content = re.sub(r'^static [^\n;]*\b' + n + r'\([^\n;{]*\);\n', '', content, flags=re.MULTILINE)
+    return re.sub(r'^static [^\n;]*\b' + n + r'\([^\n;{]*\) \{\n.*?^\}\n', '', content, flags=re.MULTILINE | re.DOTALL)
+
+# C integer conversions micropython.h implements (__PYX_MP_DEFINE_INT_AS/_FROM and friends);
+# Cython's own CIntToPy/CIntFromPy copies of these would be redefinitions
+SHIMMED_INT_CONVERSIONS = {
+    '__Pyx_PyInt_As_' + t for t in ('char', 'signed__char', 'short', 'int', 'long', 'PY_LONG_LONG',
+                                    'unsigned_char', 'unsigned_short', 'unsigned_int', 'unsigned_long',
+                                    'unsigned_PY_LONG_LONG', 'size_t')
+} | {
+    '__Pyx_PyInt_From_' + t for t in ('char', 'short', 'int', 'long', 'PY_LONG_LONG', 'unsigned_char',
+                                      'unsigned_short', 'unsigned_int', 'unsigned_long', 'unsigned_PY_LONG_LONG')
+}
+SHIMMED_FUNCTIONS = ('__Pyx_PyIndex_AsSsize_t', '__Pyx_PyInt_FromSize_t',
+                     '__Pyx_PyObject_AsString', '__Pyx_PyObject_AsStringAndSize', '__Pyx_PyUnicode_AsStringAndSize')
+SHIMMED_MACROS = ('__Pyx_PyObject_AsSString', '__Pyx_PyObject_AsUString')
+
+def drop_shimmed(content):
+    # Cython's utility code for helpers micropython.h already provides. Conversions to and
+    # from C types the header does not cover (enums, typedefs) keep Cython's versions.
+    def shimmed(section):
+        m = re.search(r'\b(__Pyx_PyInt_(?:As|From)_\w+)\(', section)
+        return m is not None and m.group(1) in SHIMMED_INT_CONVERSIONS
+    content = drop_utility(content, 'CIntToPy', shimmed)
+    content = drop_utility(content, 'CIntFromPy', shimmed)
+    if not re.search(r'^/\* CIntFromPy \*/$', content, flags=re.MULTILINE):
+        content = drop_utility(content, 'CIntFromPyVerify')
+    content = drop_utility(content, 'UnicodeEquals')
+    content = drop_utility(content, 'JoinPyUnicode')
+    content = drop_utility(content, 'dict_iter')
+    content = drop_utility(content, 'ListAppend')
+    content = drop_utility(content, 'ListCompAppend')
+    content = drop_utility(content, 'SliceObject')
+    content = drop_utility(content, 'GetItemIntUnicode')
+    for name in SHIMMED_FUNCTIONS:
+        content = drop_function(content, name)
+    for name in SHIMMED_MACROS:
+        content = re.sub(r'^#define ' + re.escape(name) + r'\(.*\n', '', content, flags=re.MULTILINE)
+    return content
+
+def traceback_bridge(content, qstrs):
+    # __Pyx_AddTraceback builds CPython code and frame objects through a bisected code
+    # object cache; on MicroPython each frame becomes one traceback entry on the pending
+    # exception instead (__Pyx_mp_add_traceback in micropython.h), named by qstrs
+    call = re.compile(r'__Pyx_AddTraceback\("([^"\\]*)", __pyx_clineno, __pyx_lineno, __pyx_filename\);')
+    def bridge(m):
+        if qstrs is not None and qstr_compatible(m.group(1)):
+            qstrs.add(m.group(1))
+            return '__Pyx_mp_add_traceback(MP_QSTR_%s, __pyx_lineno, __pyx_filename);' % qstr_escape(m.group(1))
+        return '__Pyx_mp_AddTraceback("%s", __pyx_lineno, __pyx_filename);' % m.group(1)
+    content = call.sub(bridge, content)
+    if qstrs is not None:
+        # Source file names, so interning them at the first error finds them in ROM
+        files = re.search(r'^static const char \*__pyx_f\[\] = \{\n(.*?)^\};$', content, flags=re.MULTILINE | re.DOTALL)
+        if files:
+            qstrs.update(f for f in re.findall(r'"(.*)"', files.group(1)) if qstr_compatible(f))
+    if not re.search(r'\b__Pyx_AddTraceback\((?!const char)', content):
+        for name in ('AddTraceback', 'CodeObjectCache', 'CLineInTraceback'):
+            content = drop_utility(content, name)
+    return content
+
+def wrapper_returns(content):
+    # Shims report errors as a NULL return with the exception pending; the Python-visible
+    # wrappers are where that turns into an nlr raise (__Pyx_mp_wrapper_return in micropython.h)
+    def wrap(m):
+        return re.sub(r'^(\s*)return __pyx_r;$', r'\1return __Pyx_mp_wrapper_return(__pyx_r);', m.group(0), flags=re.MULTILINE)
+    return re.sub(r'^static PyObject \*__pyx_pw_\w+\([^;{]*\) \{\n.*?^\}$', wrap, content, flags=re.MULTILINE | re.DOTALL)
+
+def stack_iterators(content):
+    # A for-loop (or unpacking) over anything but a list or tuple gets its iterator from
+    # PyObject_GetIter, which puts it on the heap. Each such call site gets its own
+    # mp_obj_iter_buf_t declared at the top of the enclosing function instead, so
+    # mp_getiter can build range, str, bytes etc. iterators on the C stack
+    # (__Pyx_mp_GetIterBuf in micropython.h). Generator bodies (__pyx_gb_*) keep their
+    # temporaries across yields, beyond the C frame, and are left alone.
+    call = re.compile(r'^([ \t]*(?:__pyx_t_\d+ = -1; )?)(__pyx_t_\d+) = PyObject_GetIter\(([^;\n]*)\);'
+                      r'( if \(unlikely\(!\2\)\) __PYX_ERR\([^)]*\)\n)'
+                      r'(?=(?:[ \t]*__Pyx_GOTREF\(\2\);\n)?[ \t]*\w+ = __Pyx_PyObject_GetIterNextFunc\(\2\);)', flags=re.MULTILINE)
+    # Function bodies open with "{" at the end of the signature or on a line of its own
+    # and close with "}" in column 0
+    bodies = [m.end() for m in re.finditer(r'^(?:[A-Za-z_][^;\n]*\)[ \t]*)?\{[ \t]*\n', content, flags=re.MULTILINE)]
+    ends = [m.start() for m in re.finditer(r'^\}', content, flags=re.MULTILINE)]
+    index = len(re.findall(r'^[ \t]*mp_obj_iter_buf_t __pyx_iter_buf_\d+;$', content, flags=re.MULTILINE))
+    edits = []
+    for m in call.finditer(content):
+        start = max((b for b in bodies if b < m.start()), default=None)
+        if start is None or any(start < e < m.start() for e in ends):
+            continue
+        signature = content[content.rfind('\n\n', 0, start) + 1:start]
+        if '__pyx_gb_' in signature:
+            continue
+        name = '__pyx_iter_buf_%d' % index
+        index += 1
+        edits.append((start, start, '  mp_obj_iter_buf_t %s;\n' % name))
+        edits.append((m.start(), m.end(), '%s%s = __Pyx_mp_GetIterBuf(%s, &%s);%s'
+                      % (m.group(1), m.group(2), m.group(3), name, m.group(4))))
+    return apply_edits(content, edits)
+
+def reset_module_state(content):
+    # Clear state left over from before a soft reset, such as a pending exception, as
+    # the module is (re)imported (__Pyx_mp_state_init in micropython.h)
+    exec_def = re.search(r'^static [^\n;]*\b__pyx_pymod_exec_\w+\(PyObject \*\w+\)$', content, flags=re.MULTILINE)
+    if exec_def is None or '__Pyx_mp_state_init();' in content:
+        return content
+    declarations = '  __Pyx_RefNannyDeclarations\n'
+    at = content.find(declarations, exec_def.end())
+    if at < 0:
+        return content
+    at += len(declarations)
+    return content[:at] + '  __Pyx_mp_state_init();\n' + content[at:]
+
+# qstrs micropython.h itself uses that MicroPython does not define (the mmap buffer type name)
+HEADER_QSTRS = {'mmap'}
+
+def write_qstrdefs(path, qstrs):
+    # Consumed by MicroPython's makeqstrdata.py, e.g. via QSTR_DEFS in the port or user module.
+    # Entries are merged so re-running over an already rewritten file keeps its qstrs.
+    qstrs = qstrs | HEADER_QSTRS
+    try:
+        with open(path, 'r') as f:
+            qstrs = qstrs | set(re.findall(r'^Q\((.*)\)$', f.read(), flags=re.MULTILINE))
+    except FileNotFoundError:
+        pass
+    with open(path, 'w') as f:
+        f.write('// Generated by modify_includes.py, do not edit\n')
+        for value in sorted(qstrs):
+            f.write('Q(%s)\n' % value)
+
+def modify_c_file(file_path, qstrs=None, rom=False, lazy=False):
     with open(file_path, 'r') as f:
         content = f.read()
     # Replace #include <Python.h> with #include "micropython.h", accounting for spaces/tabs
     modified_content = re.sub(r'^(\s*#\s*include\s*)<Python\.h>', r'\1"micropython.h"', content, flags=re.MULTILINE)
+    modified_content = drop_shimmed(modified_content)
+    if qstrs is not None:
+        modified_content = precompute_qstrs(modified_content, qstrs)
+    modified_content = traceback_bridge(modified_content, qstrs)
+    modified_content = wrapper_returns(modified_content)
+    modified_content = stack_iterators(modified_content)
+    modified_content = reset_module_state(modified_content)
+    modified_content = small_int_constants(modified_content)
+    if rom:
+        modified_content = rom_constants(modified_content)
+        modified_content = list_templates(modified_content)
+    if lazy:
+        modified_content = lazy_init(modified_content)
     with open(file_path, 'w') as f:
         f.write(modified_content)
 
 if __name__ == '__main__':
-    for file_path in sys.argv[1:]:
-        modify_c_file(file_path)
\ No newline at end of file
+    parser = argparse.ArgumentParser(description='Adapt Cython-generated C files to micropython.h')
+    parser.add_argument('--qstrdefs', metavar='FILE', help='resolve identifier strings to qstrs, writing Q() lines to FILE')
+    parser.add_argument('--rom-constants', action='store_true', help='emit constant strs, bytes and tuples as ROM objects')
+    parser.add_argument('--lazy-init', action='store_true', help='build strings, builtins and constants on first use instead of at import')
+    parser.add_argument('files', nargs='*')
+    args = parser.parse_args()
+    qstrs = set() if args.qstrdefs else None
+    for file_path in args.files:
+        modify_c_file(file_path, qstrs, args.rom_constants, args.lazy_init)
+    if args.qstrdefs:
+        write_qstrdefs(args.qstrdefs, qstrs)